@@ -573,6 +573,11 @@ INT32 BurnUpdateProgress(double fProgress, const TCHAR* pszText, bool bAbs)
 
 // ----------------------------------------------------------------------------
 
+static INT32 __cdecl BurnbprintfFiller(INT32, const TCHAR*, ...) { return 0; }
+INT32 (__cdecl *bprintf) (INT32 nStatus, const TCHAR* szFormat, ...) = BurnbprintfFiller;
+
+// ----------------------------------------------------------------------------
+
 INT32 BurnSetRefreshRate(double dFrameRate)
 {
 	nBurnFPS = (INT32)(100.0 * dFrameRate);
@@ -153,6 +153,8 @@ extern UINT32 *pBurnDrvPalette;
 #define PRINT_IMPORTANT (2)
 #define PRINT_ERROR		(3)
 
+extern INT32 (__cdecl *bprintf) (INT32 nStatus, const TCHAR* szFormat, ...);	// Application-defined message output
+
 INT32 BurnLibInit();
 INT32 BurnLibExit();
 
@@ -0,0 +1,267 @@
+#include "burnint.h"
+#include "burn_thread.h"
+
+#ifdef HAVE_THREADS
+#include <pthread.h>
+#endif
+
+static INT32 nThreadCount = 1;
+
+#ifdef HAVE_THREADS
+
+static pthread_t       thread_id[BURN_THREAD_MAX];
+static pthread_mutex_t thread_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  thread_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  thread_done = PTHREAD_COND_INITIALIZER;
+
+static BurnThreadJob   thread_job;
+static void*           thread_param;
+static INT32           thread_jobs;		// jobs in the current batch
+static INT32           thread_next;		// next job to hand out
+static INT32           thread_finished;	// jobs completed
+static UINT32          thread_batch;	// bumped for every batch
+static INT32           thread_quit;
+
+// takes jobs until the batch is empty, called with thread_lock held
+static void thread_take_jobs()
+{
+	while (thread_next < thread_jobs)
+	{
+		INT32 nJob = thread_next++;
+
+		pthread_mutex_unlock(&thread_lock);
+		thread_job(nJob, thread_param);
+		pthread_mutex_lock(&thread_lock);
+
+		if (++thread_finished == thread_jobs)
+			pthread_cond_signal(&thread_done);
+	}
+}
+
+static void* thread_main(void*)
+{
+	UINT32 nSeen = 0;
+
+	pthread_mutex_lock(&thread_lock);
+	for (;;)
+	{
+		while (!thread_quit && nSeen == thread_batch)
+			pthread_cond_wait(&thread_wake, &thread_lock);
+
+		if (thread_quit)
+			break;
+
+		nSeen = thread_batch;
+		thread_take_jobs();
+	}
+	pthread_mutex_unlock(&thread_lock);
+
+	return NULL;
+}
+
+// one background thread per slot, so independent jobs never queue behind each other
+static pthread_t       async_id[BURN_THREAD_ASYNC_SLOTS];
+static pthread_cond_t  async_wake[BURN_THREAD_ASYNC_SLOTS];
+static pthread_cond_t  async_done[BURN_THREAD_ASYNC_SLOTS];
+static BurnThreadJob   async_job[BURN_THREAD_ASYNC_SLOTS];
+static void*           async_param[BURN_THREAD_ASYNC_SLOTS];
+static INT32           async_started[BURN_THREAD_ASYNC_SLOTS];
+static INT32           async_busy[BURN_THREAD_ASYNC_SLOTS];
+static INT32           async_quit;
+
+static void* async_main(void* pSlot)
+{
+	INT32 nSlot = (INT32)(intptr_t)pSlot;
+
+	pthread_mutex_lock(&thread_lock);
+	for (;;)
+	{
+		while (!async_quit && !async_busy[nSlot])
+			pthread_cond_wait(&async_wake[nSlot], &thread_lock);
+
+		if (async_quit)
+			break;
+
+		pthread_mutex_unlock(&thread_lock);
+		async_job[nSlot](0, async_param[nSlot]);
+		pthread_mutex_lock(&thread_lock);
+
+		async_busy[nSlot] = 0;
+		pthread_cond_signal(&async_done[nSlot]);
+	}
+	pthread_mutex_unlock(&thread_lock);
+
+	return NULL;
+}
+
+static void async_stop()
+{
+	for (INT32 i = 0; i < BURN_THREAD_ASYNC_SLOTS; i++)
+		BurnThreadWaitSlot(i);
+
+	pthread_mutex_lock(&thread_lock);
+	async_quit = 1;
+	for (INT32 i = 0; i < BURN_THREAD_ASYNC_SLOTS; i++)
+		if (async_started[i])
+			pthread_cond_signal(&async_wake[i]);
+	pthread_mutex_unlock(&thread_lock);
+
+	for (INT32 i = 0; i < BURN_THREAD_ASYNC_SLOTS; i++)
+	{
+		if (async_started[i])
+		{
+			pthread_join(async_id[i], NULL);
+			pthread_cond_destroy(&async_wake[i]);
+			pthread_cond_destroy(&async_done[i]);
+		}
+		async_started[i] = 0;
+	}
+
+	async_quit = 0;
+}
+
+static void thread_stop()
+{
+	if (nThreadCount <= 1)
+		return;
+
+	pthread_mutex_lock(&thread_lock);
+	thread_quit = 1;
+	pthread_cond_broadcast(&thread_wake);
+	pthread_mutex_unlock(&thread_lock);
+
+	for (INT32 i = 0; i < nThreadCount - 1; i++)
+		pthread_join(thread_id[i], NULL);
+
+	thread_quit  = 0;
+	nThreadCount = 1;
+}
+
+#endif
+
+INT32 BurnThreadInit(INT32 nThreads)
+{
+	if (nThreads < 1)
+		nThreads = 1;
+	if (nThreads > BURN_THREAD_MAX)
+		nThreads = BURN_THREAD_MAX;
+
+#ifdef HAVE_THREADS
+	if (nThreads == nThreadCount)
+		return 0;
+
+	// a background job may be using the pool
+	for (INT32 i = 0; i < BURN_THREAD_ASYNC_SLOTS; i++)
+		BurnThreadWaitSlot(i);
+	thread_stop();
+
+	for (INT32 i = 0; i < nThreads - 1; i++)
+	{
+		if (pthread_create(&thread_id[i], NULL, thread_main, NULL))
+		{
+			bprintf(PRINT_ERROR, "BurnThreadInit: only %d of %d threads started\n", i + 1, nThreads);
+			nThreads = i + 1;
+			break;
+		}
+	}
+
+	nThreadCount = nThreads;
+#else
+	nThreadCount = 1;
+#endif
+
+	return 0;
+}
+
+INT32 BurnThreadCount()
+{
+	return nThreadCount;
+}
+
+void BurnThreadRun(BurnThreadJob pJob, INT32 nJobs, void* pParam)
+{
+#ifdef HAVE_THREADS
+	if (nThreadCount > 1 && nJobs > 1)
+	{
+		pthread_mutex_lock(&thread_lock);
+		thread_job      = pJob;
+		thread_param    = pParam;
+		thread_jobs     = nJobs;
+		thread_next     = 0;
+		thread_finished = 0;
+		thread_batch++;
+		pthread_cond_broadcast(&thread_wake);
+
+		thread_take_jobs();
+		while (thread_finished < thread_jobs)
+			pthread_cond_wait(&thread_done, &thread_lock);
+		pthread_mutex_unlock(&thread_lock);
+		return;
+	}
+#endif
+
+	for (INT32 i = 0; i < nJobs; i++)
+		pJob(i, pParam);
+}
+
+void BurnThreadAsyncSlot(INT32 nSlot, BurnThreadJob pJob, void* pParam)
+{
+#ifdef HAVE_THREADS
+	BurnThreadWaitSlot(nSlot);
+
+	if (!async_started[nSlot])
+	{
+		pthread_cond_init(&async_wake[nSlot], NULL);
+		pthread_cond_init(&async_done[nSlot], NULL);
+
+		if (pthread_create(&async_id[nSlot], NULL, async_main, (void*)(intptr_t)nSlot))
+		{
+			bprintf(PRINT_ERROR, "BurnThreadAsync: thread not started\n");
+			pJob(0, pParam);
+			return;
+		}
+		async_started[nSlot] = 1;
+	}
+
+	pthread_mutex_lock(&thread_lock);
+	async_job[nSlot]   = pJob;
+	async_param[nSlot] = pParam;
+	async_busy[nSlot]  = 1;
+	pthread_cond_signal(&async_wake[nSlot]);
+	pthread_mutex_unlock(&thread_lock);
+#else
+	pJob(0, pParam);
+#endif
+}
+
+void BurnThreadWaitSlot(INT32 nSlot)
+{
+#ifdef HAVE_THREADS
+	if (!async_started[nSlot])
+		return;
+
+	pthread_mutex_lock(&thread_lock);
+	while (async_busy[nSlot])
+		pthread_cond_wait(&async_done[nSlot], &thread_lock);
+	pthread_mutex_unlock(&thread_lock);
+#endif
+}
+
+void BurnThreadAsync(BurnThreadJob pJob, void* pParam)
+{
+	BurnThreadAsyncSlot(0, pJob, pParam);
+}
+
+void BurnThreadWait()
+{
+	BurnThreadWaitSlot(0);
+}
+
+void BurnThreadExit()
+{
+#ifdef HAVE_THREADS
+	async_stop();
+	thread_stop();
+#endif
+	nThreadCount = 1;
+}
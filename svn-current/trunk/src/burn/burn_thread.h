@@ -0,0 +1,28 @@
+#ifndef _BURN_THREAD_H
+#define _BURN_THREAD_H
+
+#define BURN_THREAD_MAX			8
+#define BURN_THREAD_ASYNC_SLOTS	2
+
+// job callback, nJob runs from 0 to nJobs - 1 in no particular order
+typedef void (*BurnThreadJob)(INT32 nJob, void* pParam);
+
+// nThreads counts the calling thread, 1 runs everything in the caller
+INT32 BurnThreadInit(INT32 nThreads);
+INT32 BurnThreadCount();
+
+// runs all jobs on the pool and the calling thread, returns when every job is done
+void BurnThreadRun(BurnThreadJob pJob, INT32 nJobs, void* pParam);
+
+// runs one job on a background thread and returns at once, BurnThreadWait
+// blocks until it is done; without threads the job runs before returning
+void BurnThreadAsync(BurnThreadJob pJob, void* pParam);
+void BurnThreadWait();
+
+// the same on background thread nSlot, slot 0 is the one above
+void BurnThreadAsyncSlot(INT32 nSlot, BurnThreadJob pJob, void* pParam);
+void BurnThreadWaitSlot(INT32 nSlot);
+
+void BurnThreadExit();
+
+#endif
@@ -11,7 +11,7 @@
 extern UINT8 cps3_reset;
 extern UINT8 cps3_palette_change;
 
-extern UINT16 *Cps3CurPal;
+extern UINT8 *Cps3CurPal;
 
 extern UINT32 cps3_key1, cps3_key2, cps3_isSpecial;
 extern UINT32 cps3_bios_test_hack, cps3_game_test_hack;
@@ -41,6 +41,7 @@ void __fastcall cps3SndWriteLong(UINT32 addr, UINT32 data);
 INT32 cps3SndInit(UINT8 *);
 void cps3SndSetRoute(INT32 nIndex, double nVolume, INT32 nRouteDir);
 void cps3SndExit(void);
+void cps3SndNewFrame(INT32 nCycles);
 void cps3SndUpdate(void);
 
 INT32 cps3SndScan(INT32);
@@ -19,9 +19,17 @@ Port to FBA by OopsWare
 
 #include "cps3.h"
 #include "sh2_intf.h"
+#include "burn_thread.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CPS3_ROW_SSE2	1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CPS3_ROW_NEON	1
+#endif
 
 #define BE_GFX	1
-#define SPEED_HACK 1 // Default should be 1, if not FPS would drop.
 
 #ifdef WII_VM
 #include "libretro.h"
@@ -53,8 +61,66 @@ static UINT8 *RamC000_D;
 
 static UINT16 *EEPROM;
 
-UINT16 *Cps3CurPal;
+UINT8 *Cps3CurPal;		// UINT16 or UINT32 entries, see cps3_bpp
 static UINT32 *RamScreen;
+static UINT32 *SprDrawn;		// sprite ram as of the last rendered frame
+static UINT32 *SSDrawn;			// 'SS' ram as of the last drawn text layer
+static UINT32 *VRegDrawn;		// video registers as of the last rendered frame
+static UINT8 *PalDrawn;		// Cps3CurPal for a pipelined frame
+static UINT8 *FrameDrawn;		// pipelined frame output
+static UINT32 *CRamDrawn;		// char ram for a pipelined frame, allocated on demand
+static UINT16 *PalShadow;		// RamPal as converted into Cps3CurPal
+static UINT32 *PalLut;			// 15 bit colour to the frame format
+
+#define CPS3_PAL_BLOCK		0x100
+static UINT8 cps3_pal_dirty[0x20000 / CPS3_PAL_BLOCK];
+static INT32 cps3_pal_check = 0;	// RamPal was replaced, compare it with PalShadow
+
+// The renderer only reads the *Drawn copies and the Draw* pointers below.
+// Without the pipeline the pointers are the live memory and the frame is
+// drawn straight into pBurnDraw. With it, DrvDraw hands the frame to a
+// background thread and shows the one finished a frame earlier.
+INT32 EnableRenderPipeline = 0;
+
+static INT32 cps3_pipelined = 0;
+static UINT32 *DrawCRam;
+static UINT8 *DrawPal;
+static UINT8 *DrawDest;
+static UINT8 cps3_cram_pages[0x80];	// char ram pages changed since the last pipelined frame
+
+// bytes per frame pixel, nBurnBpp is 2 (RGB565 or 555) or 4 (XRGB8888)
+#define cps3_bpp		(nBurnBpp == 4 ? 4 : 2)
+
+struct cps3_frame_job
+{
+	UINT32 fsz;
+	UINT32 bands;
+	UINT32 dirty;
+	UINT32 ss_base;
+	UINT32 ss_pal;
+	INT32 width;
+	INT32 bpp;
+};
+
+static cps3_frame_job cps3_job;
+
+// sprite list parsed into draw commands, see DrvDrawScreen
+#define CPS3_MAX_CMD		0x2000
+
+struct cps3_draw_cmd
+{
+	UINT32 code;				// 0 for a tilemap, pal is the tilemap number then
+	UINT32 pal;
+	INT32 flipx, flipy;
+	INT32 x, y;
+	INT32 xinc, yinc;
+	INT32 alpha;
+};
+
+static cps3_draw_cmd *DrawCmd;
+static INT32 cps3_cmd_count;
+static INT32 cps3_band_count;
+static INT32 cps3_band_clear;
 
 UINT8 cps3_reset = 0;
 UINT8 cps3_palette_change = 0;
@@ -91,6 +157,22 @@ static UINT32 chardma_table_address = 0;
 static INT32 cps3_gfx_width, cps3_gfx_height;
 static INT32 cps3_gfx_max_x, cps3_gfx_max_y;
 
+// Video memory writes are tracked per 64KB page: the pages start out with
+// their write side on handler 5, the first write marks the page and maps
+// it straight back to memory. DrvDraw folds the marks into cps3_dirty and
+// protects the pages again.
+#define CPS3_DIRTY_GFX		(1)		// sprites, tilemaps, char ram or video registers
+#define CPS3_DIRTY_PAL		(2)		// every output pixel needs converting again
+#define CPS3_DIRTY_ALL		(CPS3_DIRTY_GFX | CPS3_DIRTY_PAL)
+
+static UINT32 cps3_dirty = CPS3_DIRTY_ALL;
+static UINT32 cps3_spr_written = 0;		// one bit per sprite ram page
+static UINT32 cps3_ss_written = 0;
+static UINT32 cps3_cram_written = 0;
+
+static UINT32 cps3_drawn_fsz, cps3_drawn_width, cps3_drawn_layer, cps3_drawn_sprite;
+static UINT32 cps3_drawn_ss_bank, cps3_drawn_ss_pal;
+
 // -- AMD/Fujitsu 29F016 --------------------------------------------------
 
 enum
@@ -276,173 +358,193 @@ static void cps3_decrypt_game(void)
 	}
 }
 
-static INT32 last_normal_byte = 0;
+#include "cps3_chardma.inc"
 
-static UINT32 process_byte( UINT8 real_byte, UINT32 destination, INT32 max_length )
+// Decoded char dma output, the bytes depend on the rom alone as long as the
+// transfer ends short of the end of char ram. Keyed on source, table and
+// length, least recently used entries go once CharDmaCacheMB is reached.
+INT32 CharDmaCacheMB = 0;
+
+#define CPS3_DMA_CACHE_HASH		4096
+
+struct cps3_dma_cache_entry
 {
-   UINT8 * dest = (UINT8 *) RamCRam;
-   destination &= 0x7fffff;
+	UINT32 source, table, length;
+	UINT32 size;	// bytes written, runs can overshoot the length
+	cps3_dma_cache_entry * hash_next;
+	cps3_dma_cache_entry * prev;	// lru list, most recent first
+	cps3_dma_cache_entry * next;
+	// followed by the data
+};
 
-   if (real_byte&0x40)
-   {
-      INT32 tranfercount    = 0;
-      INT32 cps3_rle_length = (real_byte&0x3f)+1;
-      while (cps3_rle_length)
-      {
-#if BE_GFX
-         dest[((destination+tranfercount)&0x7fffff)]   = (last_normal_byte&0x3f);
-#else
-         dest[((destination+tranfercount)&0x7fffff)^3] = (last_normal_byte&0x3f);
-#endif
-         tranfercount++;
-         cps3_rle_length--;
-         max_length--;
-         if ((destination+tranfercount) > 0x7fffff)
-            return max_length;
-      }
-      return tranfercount;
-   }
-#if BE_GFX
-   dest[(destination&0x7fffff)]   = real_byte;
-#else
-   dest[(destination&0x7fffff)^3] = real_byte;
-#endif
-   last_normal_byte = real_byte;
-   return 1;
-}
+static cps3_dma_cache_entry * cps3_dma_cache_hash[CPS3_DMA_CACHE_HASH];
+static cps3_dma_cache_entry * cps3_dma_cache_head = NULL;
+static cps3_dma_cache_entry * cps3_dma_cache_tail = NULL;
+static UINT32 cps3_dma_cache_used = 0;
+static UINT32 cps3_dma_cache_cap = 0;
+static INT32 cps3_dma_cache_mb = 0;
 
-static void cps3_do_char_dma(
-      UINT32 real_source, UINT32 real_destination, UINT32 real_length )
+static inline UINT32 cps3_dma_cache_slot(UINT32 source, UINT32 table, UINT32 length)
 {
-	UINT8 * sourcedata     = RomUser;
-	INT32 length_remaining = real_length;
-	last_normal_byte       = 0;
-	while (length_remaining)
-	{
-		UINT8 current_byte  = sourcedata[ real_source ^ 0 ];
-		real_source++;
+	return ((source * 0x9e3779b1) ^ (table * 0x85ebca6b) ^ (length * 0xc2b2ae35)) >> 20;
+}
 
-		if (current_byte & 0x80)
-      {
-         UINT8 real_byte;
-         UINT32 length_processed;
-         current_byte &= 0x7f;
-
-         real_byte         = sourcedata[ (chardma_table_address+current_byte*2+0) ^ 0 ];
-         length_processed  = process_byte( real_byte, real_destination, length_remaining );
-         length_remaining -= length_processed; // subtract the number of bytes the operation has taken
-         real_destination += length_processed; // add it onto the destination
-         if (real_destination>0x7fffff)
-            return;
-         if (length_remaining<=0)
-            return; // if we've expired, exit
-
-         real_byte = sourcedata[ (chardma_table_address+current_byte*2+1) ^ 0 ];
-         length_processed = process_byte( real_byte, real_destination, length_remaining );
-         length_remaining -= length_processed; // subtract the number of bytes the operation has taken
-         real_destination += length_processed; // add it onto the destination
-         if (real_destination>0x7fffff)
-            return;
-         if (length_remaining<=0)
-            return;  // if we've expired, exit
-      }
-		else
-		{
-			UINT32 length_processed;
-			length_processed = process_byte( current_byte, real_destination, length_remaining );
-			length_remaining -= length_processed; // subtract the number of bytes the operation has taken
-			real_destination += length_processed; // add it onto the destination
-			if (real_destination>0x7fffff)
-				return;
-			if (length_remaining<=0)
-				return;  // if we've expired, exit
-		}
-	}
+static void cps3_dma_cache_unlink(cps3_dma_cache_entry * e)
+{
+	if (e->prev) e->prev->next = e->next; else cps3_dma_cache_head = e->next;
+	if (e->next) e->next->prev = e->prev; else cps3_dma_cache_tail = e->prev;
 }
 
-static UINT16 lastb;
-static UINT16 lastb2;
+static void cps3_dma_cache_push(cps3_dma_cache_entry * e)
+{
+	e->prev = NULL;
+	e->next = cps3_dma_cache_head;
+	if (cps3_dma_cache_head) cps3_dma_cache_head->prev = e; else cps3_dma_cache_tail = e;
+	cps3_dma_cache_head = e;
+}
 
-static UINT32 ProcessByte8(UINT8 b, UINT32 dst_offset)
+static void cps3_dma_cache_evict(void)
 {
-	UINT8 * destRAM = (UINT8 *) RamCRam;
- 	INT32 l=0;
+	cps3_dma_cache_entry * e = cps3_dma_cache_tail;
+	cps3_dma_cache_entry ** link = &cps3_dma_cache_hash[cps3_dma_cache_slot(e->source, e->table, e->length)];
 
- 	if(lastb==lastb2) /* RLE */
-	{
- 		INT32 rle=(b+1)&0xff;
+	while (*link != e)
+		link = &(*link)->hash_next;
+	*link = e->hash_next;
 
- 		for(INT32 i=0;i<rle;++i)
-		{
-#if BE_GFX
-			destRAM[(dst_offset&0x7fffff)] = lastb;
-#else
-			destRAM[(dst_offset&0x7fffff)^3] = lastb;
-#endif
-			dst_offset++;
- 			++l;
- 		}
- 		lastb2=0xffff;
- 	}
-	else
-	{
- 		lastb2=lastb;
- 		lastb=b;
-#if BE_GFX
-		destRAM[(dst_offset&0x7fffff)] = b;
-#else
-		destRAM[(dst_offset&0x7fffff)^3] = b;
-#endif
- 	}
-	return 1;
+	cps3_dma_cache_unlink(e);
+	cps3_dma_cache_used -= e->size;
+	free(e);
 }
 
-static void cps3_do_alt_char_dma(
-      UINT32 src, UINT32 real_dest, UINT32 real_length )
+// no transfer may be running, 0 frees the lot
+static void cps3_dma_cache_set(INT32 nMB)
 {
-   UINT8 * px   = RomUser;
-   UINT32 start = real_dest;
-   UINT32 ds    = real_dest;
+	cps3_dma_cache_mb  = nMB;
+	cps3_dma_cache_cap = (nMB > 0) ? (UINT32)nMB << 20 : 0;
 
-   lastb=0xfffe;
-   lastb2=0xffff;
+	while (cps3_dma_cache_used > cps3_dma_cache_cap || (!cps3_dma_cache_cap && cps3_dma_cache_tail))
+		cps3_dma_cache_evict();
+}
 
-   for(;;)
+static void cps3_cached_char_dma(
+      UINT32 real_source, UINT32 real_destination, UINT32 real_length, UINT32 table_address )
+{
+#if BE_GFX
+	if (cps3_dma_cache_cap && real_destination < 0x800000)
    {
-      UINT8 ctrl=px[ src ^ 0 ];
-      ++src;
+		UINT8 * dest = (UINT8 *) RamCRam;
+		cps3_dma_cache_entry ** slot = &cps3_dma_cache_hash[cps3_dma_cache_slot(real_source, table_address, real_length)];
+		cps3_dma_cache_entry * e;
 
-      for(INT32 i=0;i<8;++i)
-      {
-         UINT8 p = px[ src ^ 0 ];
+		for (e = *slot; e; e = e->hash_next)
+			if (e->source == real_source && e->table == table_address && e->length == real_length)
+				break;
 
-         if(ctrl&0x80)
+		if (e)
+      {
+			if (real_destination + e->size < 0x800000)
          {
-            UINT8 real_byte;
-            p &= 0x7f;
-            real_byte = px[ (chardma_table_address+p*2+0) ^ 0 ];
-            ds += ProcessByte8(real_byte,ds);
-            real_byte = px[ (chardma_table_address+p*2+1) ^ 0 ];
-            ds += ProcessByte8(real_byte,ds);
-         }
-         else
-            ds += ProcessByte8(p,ds);
-         ++src;
-         ctrl<<=1;
+				memcpy(dest + real_destination, e + 1, e->size);
+				cps3_dma_cache_unlink(e);
+				cps3_dma_cache_push(e);
+				return;
+			}
+			cps3_do_char_dma(real_source, real_destination, real_length, table_address);
+			return;
+		}
 
-         if((ds-start)>=real_length)
-            return;
-      }
-   }
+		cps3_chardma_clipped = 0;
+		UINT32 end  = cps3_do_char_dma(real_source, real_destination, real_length, table_address);
+		UINT32 size = end - real_destination;
+
+		if (cps3_chardma_clipped || end >= 0x800000 || size > cps3_dma_cache_cap)
+			return;
+
+		while (cps3_dma_cache_used + size > cps3_dma_cache_cap)
+			cps3_dma_cache_evict();
+
+		e = (cps3_dma_cache_entry *)malloc(sizeof(cps3_dma_cache_entry) + size);
+		if (e == NULL)
+			return;
+
+		e->source    = real_source;
+		e->table     = table_address;
+		e->length    = real_length;
+		e->size      = size;
+		e->hash_next = *slot;
+		*slot        = e;
+		memcpy(e + 1, dest + real_destination, size);
+		cps3_dma_cache_push(e);
+		cps3_dma_cache_used += size;
+		return;
+	}
+#endif
+	cps3_do_char_dma(real_source, real_destination, real_length, table_address);
 }
 
-static void cps3_process_character_dma(UINT32 address)
+// marks the char ram pages a dma may write, rle runs can overshoot the length
+static void cps3_cram_touch(UINT8 * pages, UINT32 dest, UINT32 length)
+{
+	UINT32 end = (dest & 0x7fffff) + length + 0x100;
+
+	if (end > 0x800000)
+		end = 0x800000;
+	for (UINT32 page = (dest & 0x7fffff) >> 16; page < ((end + 0xffff) >> 16); page++)
+		pages[page] = 1;
+}
+
+// dma writes bypass the SH-2, drop any code it cached from the bank it sees
+static void cps3_cram_invalidate(UINT32 dest, UINT32 length)
+{
+	UINT32 start = dest & 0x7fffff;
+	UINT32 end   = start + length + 0x100;
+	UINT32 bank  = cram_bank << 20;
+
+	if (start < bank)
+		start = bank;
+	if (end > bank + 0x100000)
+		end = bank + 0x100000;
+	if (start < end)
+		Sh2InvalidateCode(0x04100000 + start - bank, 0x04100000 + end - bank - 1);
+}
+
+// With EnableAsyncCharDma the list is decoded on a background thread. The
+// SH-2 stalls on the char ram pages it writes until it is done, and irq 10
+// comes once the transfer would have finished, by vblank at the latest.
+INT32 EnableAsyncCharDma = 0;
+
+#define CPS3_CHARDMA_TOUCH			1	// mark what the list writes for the renderer
+#define CPS3_CHARDMA_STALL			2	// and for the stall handler
+#define CPS3_CHARDMA_RUN			4	// do the transfers
+
+#define CPS3_CHARDMA_BYTES_PER_CYCLE	4
+
+#define CPS3_CHARDMA_LIST_WORDS		(0x1000 + 2)	// the last entry starts at word 0xfff
+
+// the background job walks a copy of the list, the SH-2 may rewrite the
+// original, and keeps its own table address until it is done
+static UINT32 cps3_chardma_list[CPS3_CHARDMA_LIST_WORDS];
+static UINT32 cps3_chardma_table;
+static UINT32 cps3_chardma_bytes;
+static UINT8 cps3_chardma_pages[0x80];
+static INT32 cps3_chardma_busy = 0;
+static INT32 cps3_chardma_irq = 0;
+static INT32 cps3_chardma_irq_cycle;
+
+static void cps3_chardma_stall(INT32 on);
+
+// walks a char dma list, returns the number of entries that raise irq 10.
+// Table entries update *table whatever the mode.
+static INT32 cps3_character_dma_list(const UINT32 * list, UINT32 * table, INT32 nMode)
 {
+	INT32 nIrq = 0;
+
 	for (INT32 i=0; i<0x1000; i+=3)
 	{
-		UINT32 dat1             = RamCRam[i+0+(address)];
-		UINT32 dat2             = RamCRam[i+1+(address)];
-		UINT32 dat3             = RamCRam[i+2+(address)];
+		UINT32 dat1             = list[i+0];
+		UINT32 dat2             = list[i+1];
+		UINT32 dat3             = list[i+2];
 		UINT32 real_source      = (dat3<<1)-0x400000;
 		UINT32 real_destination =  dat2<<3;
 		UINT32 real_length      = (((dat1&0x001fffff)+1)<<3);
@@ -451,33 +553,130 @@ static void cps3_process_character_dma(UINT32 address)
          break;	// end of list marker
 		if (dat1 == 0x13131313)
          break;	// our default fill
+
+		if (nMode & CPS3_CHARDMA_TOUCH)
+      {
+			cps3_dirty |= CPS3_DIRTY_GFX;
+			cps3_cram_touch(cps3_cram_pages, real_destination, real_length);
+			cps3_cram_invalidate(real_destination, real_length);
+		}
+		if (nMode & CPS3_CHARDMA_STALL)
+      {
+			cps3_cram_touch(cps3_chardma_pages, real_destination, real_length);
+			cps3_chardma_bytes += real_length;
+		}
 		
 		switch ( dat1 & 0x00e00000 )
       {
          case 0x00800000:
-            chardma_table_address = real_source;
-            Sh2SetIRQLine(10, SH2_IRQSTATUS_AUTO);
+            *table = real_source;
+            nIrq++;
             break;
          case 0x00400000:
-            cps3_do_char_dma( real_source, real_destination, real_length );
-            Sh2SetIRQLine(10, SH2_IRQSTATUS_AUTO);
+            if (nMode & CPS3_CHARDMA_RUN)
+               cps3_cached_char_dma( real_source, real_destination, real_length, *table );
+            nIrq++;
             break;
          case 0x00600000:
             /* 8bpp DMA decompression
                - this is used on SFIII NG Sean's Stage ONLY */
-            cps3_do_alt_char_dma( real_source, real_destination, real_length );
-            Sh2SetIRQLine(10, SH2_IRQSTATUS_AUTO);
+            if (nMode & CPS3_CHARDMA_RUN)
+               cps3_do_alt_char_dma( real_source, real_destination, real_length, *table );
+            nIrq++;
             break;
          case 0x00000000:
             // Red Earth need this. 8192 byte trans to 0x00003000 (from 0x007ec000???)
             // seems some stars(6bit alpha) without compress
-            memcpy( (UINT8 *)RamCRam + real_destination, RomUser + real_source, real_length );
-            Sh2SetIRQLine(10, SH2_IRQSTATUS_AUTO);
+            if (nMode & CPS3_CHARDMA_RUN)
+               memcpy( (UINT8 *)RamCRam + real_destination, RomUser + real_source, real_length );
+            nIrq++;
             break;
          default:
             break;
       }
 	}
+
+	return nIrq;
+}
+
+static void cps3_chardma_job(INT32, void*)
+{
+	cps3_character_dma_list(cps3_chardma_list, &cps3_chardma_table, CPS3_CHARDMA_RUN);
+}
+
+// waits for a background char dma and gives its pages back to the SH-2
+static void cps3_chardma_finish(void)
+{
+	if (!cps3_chardma_busy)
+		return;
+
+	BurnThreadWaitSlot(1);
+	cps3_chardma_busy = 0;
+
+	for (INT32 i = 0; i < 0x10; i++)
+   {
+		if (cps3_chardma_pages[(cram_bank << 4) | i])
+      {
+			UINT32 page = 0x04100000 + (i << 16);
+			Sh2MapMemory((UINT8 *)RamCRam + (cram_bank << 20) + (i << 16), page, page | 0xffff, SH2_READ);
+			Sh2MapHandler(5, page, page | 0xffff, SH2_WRITE);
+			Sh2InvalidateCode(page, page | 0xffff);	// fetches were not stalled
+		}
+	}
+	memset(cps3_chardma_pages, 0, sizeof(cps3_chardma_pages));
+	cps3_chardma_stall(0);
+}
+
+// delivers the completion irq of a background char dma
+static void cps3_chardma_raise(void)
+{
+	cps3_chardma_finish();
+	cps3_chardma_irq = 0;
+	Sh2SetIRQLine(10, SH2_IRQSTATUS_AUTO);
+}
+
+static void cps3_process_character_dma(UINT32 address)
+{
+	// the list lives in char ram, a dma still running may be writing it
+	cps3_chardma_finish();
+
+	if (!EnableAsyncCharDma)
+   {
+		if (cps3_character_dma_list(RamCRam + address, &chardma_table_address, CPS3_CHARDMA_TOUCH | CPS3_CHARDMA_RUN))
+			Sh2SetIRQLine(10, SH2_IRQSTATUS_AUTO);
+		return;
+	}
+
+	// both walks see the same list, the job starts from the table address
+	// in force now and chardma_table_address moves on to where it ends
+	memcpy(cps3_chardma_list, RamCRam + address, sizeof(cps3_chardma_list));
+	cps3_chardma_table = chardma_table_address;
+	cps3_chardma_bytes = 0;
+	if (!cps3_character_dma_list(cps3_chardma_list, &chardma_table_address, CPS3_CHARDMA_TOUCH | CPS3_CHARDMA_STALL))
+   {
+		memset(cps3_chardma_pages, 0, sizeof(cps3_chardma_pages));
+		return;
+	}
+
+	// the SH-2 sees the current bank only, other banks are reached through dma alone
+	cps3_chardma_stall(1);
+	for (INT32 i = 0; i < 0x10; i++)
+   {
+		if (cps3_chardma_pages[(cram_bank << 4) | i])
+      {
+			UINT32 page = 0x04100000 + (i << 16);
+			Sh2MapHandler(6, page, page | 0xffff, SH2_READ | SH2_WRITE);
+		}
+	}
+
+	cps3_chardma_busy = 1;
+	BurnThreadAsyncSlot(1, cps3_chardma_job, NULL);
+
+	if (!cps3_chardma_irq)
+   {
+		cps3_chardma_irq       = 1;
+		cps3_chardma_irq_cycle = Sh2TotalCycles() + cps3_chardma_bytes / CPS3_CHARDMA_BYTES_PER_CYCLE;
+	}
 }
 
 static INT32 MemIndex(void)
@@ -516,13 +715,91 @@ static INT32 MemIndex(void)
 	
 	RamEnd		= Next;
 	
-	Cps3CurPal	= (UINT16 *) Next; Next += 0x020001 * sizeof(UINT16); // iq_132 - layer disable
+	SprDrawn	= (UINT32 *) Next; Next += 0x0020000 * sizeof(UINT32);
+	SSDrawn		= (UINT32 *) Next; Next += 0x0004000 * sizeof(UINT32);
+	VRegDrawn	= (UINT32 *) Next; Next += 0x0000040 * sizeof(UINT32);
+	PalDrawn	= Next; Next += 0x020002 * sizeof(UINT32);	// +1, the output stage reads 32 bits
+	FrameDrawn	= Next; Next += 496 * 224 * sizeof(UINT32);
+	DrawCmd		= (cps3_draw_cmd *) Next; Next += CPS3_MAX_CMD * sizeof(cps3_draw_cmd);
+	
+	Cps3CurPal	= Next; Next += 0x020002 * sizeof(UINT32); // iq_132 - layer disable, +1 for the output stage
+	PalShadow	= (UINT16 *) Next; Next += 0x0020000 * sizeof(UINT16);
+	PalLut		= (UINT32 *) Next; Next += 0x0008000 * sizeof(UINT32);
 	RamScreen	= (UINT32 *) Next; Next += (512 * 2) * (224 * 2 + 32) * sizeof(UINT32);
 	
 	MemEnd		= Next;
 	return 0;
 }
 
+static void cps3_palette_lut(void)
+{
+	for (INT32 data = 0; data < 0x8000; data++)
+   {
+		INT32 r = (data & 0x001F) << 3;	// Red
+		INT32 g = (data & 0x03E0) >> 2;	// Green
+		INT32 b = (data & 0x7C00) >> 7;	// Blue
+		r |= r >> 5;
+		g |= g >> 5;
+		b |= b >> 5;
+		PalLut[data] = BurnHighColSwitch(r, g, b, 0);
+	}
+}
+
+template <typename T>
+static void cps3_palette_convert(T * pal, UINT32 start, UINT32 count)
+{
+	for (UINT32 i = start; i < start + count; i++)
+   {
+#ifdef MSB_FIRST
+		UINT32 data = RamPal[i];
+		PalShadow[i] = data;
+#else
+		UINT32 data = RamPal[i ^ 1];
+		PalShadow[i ^ 1] = data;
+#endif
+		pal[i] = PalLut[data & 0x7fff];
+	}
+}
+
+// converts RamPal entries into Cps3CurPal and remembers what was converted
+static void cps3_palette_convert(UINT32 start, UINT32 count)
+{
+	if (cps3_bpp == 4)
+		cps3_palette_convert((UINT32 *)Cps3CurPal, start, count);
+	else
+		cps3_palette_convert((UINT16 *)Cps3CurPal, start, count);
+	cps3_dirty |= CPS3_DIRTY_PAL;
+}
+
+// brings Cps3CurPal up to date with RamPal, block by block
+static void cps3_palette_update(void)
+{
+	if (cps3_palette_change)
+   {
+		// the frontend changed the colour format
+		cps3_palette_lut();
+		memset(cps3_pal_dirty, 1, sizeof(cps3_pal_dirty));
+		cps3_palette_change = 0;
+	}
+
+	if (cps3_pal_check)
+   {
+		for (INT32 i = 0; i < 0x20000 / CPS3_PAL_BLOCK; i++)
+			if (memcmp(RamPal + i * CPS3_PAL_BLOCK, PalShadow + i * CPS3_PAL_BLOCK, CPS3_PAL_BLOCK * sizeof(UINT16)))
+				cps3_pal_dirty[i] = 1;
+		cps3_pal_check = 0;
+	}
+
+	for (INT32 i = 0; i < 0x20000 / CPS3_PAL_BLOCK; i++)
+   {
+		if (cps3_pal_dirty[i])
+      {
+			cps3_palette_convert(i * CPS3_PAL_BLOCK, CPS3_PAL_BLOCK);
+			cps3_pal_dirty[i] = 0;
+		}
+	}
+}
+
 UINT8 __fastcall cps3ReadByte(UINT32 addr)
 {
 	addr &= 0xc7ffffff;
@@ -628,8 +905,10 @@ void __fastcall cps3WriteWord(UINT32 addr, UINT16 data)
       case 0x040c0086:
          if (cram_bank != data)
          {
+            cps3_chardma_finish();
             cram_bank = data & 7;
-            Sh2MapMemory(((UINT8 *)RamCRam) + (cram_bank << 20), 0x04100000, 0x041fffff, SH2_RAM);
+            Sh2MapMemory(((UINT8 *)RamCRam) + (cram_bank << 20), 0x04100000, 0x041fffff, SH2_READ | SH2_FETCH);
+            Sh2MapHandler(5, 0x04100000, 0x041fffff, SH2_WRITE);
          }
          break;
       case 0x040c0088:
@@ -677,11 +956,11 @@ void __fastcall cps3WriteWord(UINT32 addr, UINT16 data)
                UINT16 coltmp  = src[(paldma_source - 0x200000 + i)];
                UINT16 coldata = (coltmp << 8) | (coltmp >> 8);
 #endif
-               UINT32 r       = (coldata & 0x001F) >>  0;
-               UINT32 g       = (coldata & 0x03E0) >>  5;
-               UINT32 b       = (coldata & 0x7C00) >> 10;
                if (paldma_fade != 0)
                {
+                  UINT32 r   = (coldata & 0x001F) >>  0;
+                  UINT32 g   = (coldata & 0x03E0) >>  5;
+                  UINT32 b   = (coldata & 0x7C00) >> 10;
                   INT32 fade = (paldma_fade & 0x3f000000)>>24;
                   r          = (r * fade) >> 5;
                   if (r > 0x1f)
@@ -697,17 +976,13 @@ void __fastcall cps3WriteWord(UINT32 addr, UINT16 data)
                   coldata    = (r << 0) | (g << 5) | (b << 10);
                }
 
-               r = r << 3;
-               g = g << 3;
-               b = b << 3;
-
 #ifdef MSB_FIRST
                RamPal[(paldma_dest + i)]      = coldata;
 #else
                RamPal[(paldma_dest + i) ^ 1]  = coldata;
 #endif
-               Cps3CurPal[(paldma_dest + i) ] = BurnHighCol(r, g, b, 0);
             }
+            cps3_palette_convert(paldma_dest, paldma_length);
             Sh2SetIRQLine(10, SH2_IRQSTATUS_AUTO);
          }
          break;
@@ -750,10 +1025,15 @@ void __fastcall cps3WriteWord(UINT32 addr, UINT16 data)
 
             addr &= 0xff;
 #ifdef MSB_FIRST
-            ((UINT16 *)RamVReg)[ (addr >> 1) ] = data;
+            UINT16 * vreg = ((UINT16 *)RamVReg) + (addr >> 1);
 #else
-            ((UINT16 *)RamVReg)[ (addr >> 1) ^ 1 ] = data;
+            UINT16 * vreg = ((UINT16 *)RamVReg) + ((addr >> 1) ^ 1);
 #endif
+            if (*vreg != data)
+            {
+               *vreg       = data;
+               cps3_dirty |= CPS3_DIRTY_GFX;
+            }
 
          }
          else if ((addr >= 0x05000000) && (addr < 0x05001000)) { }
@@ -781,10 +1061,37 @@ static void __fastcall cps3C0WriteLong(UINT32 addr, UINT32 data)
 	{
 		*(UINT32 *)(RamC000 + (addr & 0x3ff))   = data;
 		*(UINT32 *)(RamC000_D + (addr & 0x3ff)) = data ^ cps3_mask(addr, cps3_key1, cps3_key2);
+		Sh2InvalidateCode(addr, addr + 3);
 	}
 }
 
-// If fastboot != 1 
+// Game ROM reads go straight to memory. Handler 2 is only mapped for reads
+// while the flash is in a command mode, or while the ROM test may be running
+// (it checksums the encrypted data, see cps3RomReadLong).
+
+static INT32 cps3_rom_handler;	// reads mapped to handler 2, -1 before the first map
+static INT32 cps3_rom_test;		// frames left of ROM test, -1 without pc watch
+
+static void cps3_rom_map()
+{
+	INT32 handler = (main_flash.flash_mode != FM_NORMAL || cps3_rom_test) ? 1 : 0;
+
+	if (handler == cps3_rom_handler)
+		return;
+
+	cps3_rom_handler = handler;
+	if (handler)
+		Sh2MapHandler(2, 0x06000000, 0x06ffffff, SH2_READ);
+	else
+		Sh2MapMemory(cps3_isSpecial ? RomGame : RomGame_D, 0x06000000, 0x06ffffff, SH2_READ);
+}
+
+// the cpu entered the code around a test hack pc, checked before each of its blocks
+static void cps3_rom_test_hit(UINT32)
+{
+	cps3_rom_test = 2;
+	cps3_rom_map();
+}
 
 static UINT8 __fastcall cps3RomReadByte(UINT32 addr)
 {
@@ -833,11 +1140,13 @@ static void __fastcall cps3RomWriteLong(UINT32 addr, UINT32 data)
 	{
 		addr &= 0x00ffffff;
 		cps3_flash_write(&main_flash, addr, data);
+		cps3_rom_map();
 		
 		if ( main_flash.flash_mode == FM_NORMAL )
       {
 			*(UINT32 *)(RomGame + addr) = data;
 			*(UINT32 *)(RomGame_D + addr) = data ^ cps3_mask(addr + 0x06000000, cps3_key1, cps3_key2);
+			Sh2InvalidateCode(addr + 0x06000000, addr + 0x06000003);
 		}
 	}
 }
@@ -890,25 +1199,149 @@ static void __fastcall cps3VidWriteWord(UINT32 addr, UINT16 data)
 #else
       RamPal[palindex ^ 1] = data;
 #endif
+      cps3_palette_convert(palindex, 1);
+   }
+}
 
-      INT32 r = (data & 0x001F) << 3;	// Red
-      INT32 g = (data & 0x03E0) >> 2;	// Green
-      INT32 b = (data & 0x7C00) >> 7;	// Blue
+static void __fastcall cps3VidWriteLong(UINT32 addr, UINT32 data)
+{
+	addr &= 0xc7ffffff;
+}
 
-      r |= r >> 5;
-      g |= g >> 5;
-      b |= b >> 5;
+static void cps3_track_arm(void)
+{
+	Sh2MapHandler(5, 0x04000000, 0x0407ffff, SH2_WRITE);	// sprite ram
+	Sh2MapHandler(5, 0x04100000, 0x041fffff, SH2_WRITE);	// char ram window
+	Sh2MapHandler(5, 0x05040000, 0x0504ffff, SH2_WRITE);	// 'SS' ram
+}
 
-      Cps3CurPal[palindex] = BurnHighCol(r, g, b, 0);
+// first write to a protected page since the last DrvDraw
+static UINT8 * cps3_track_page(UINT32 addr)
+{
+	UINT32 page = addr & 0xffff0000;
+	UINT8 * mem;
+
+	if (page >= 0x05040000) {
+		cps3_ss_written = 1;
+		mem = (UINT8 *)RamSS;
+	} else if (page >= 0x04100000) {
+		cps3_cram_written = 1;
+		cps3_cram_pages[(cram_bank << 4) | ((page >> 16) & 0x0f)] = 1;
+		mem = (UINT8 *)RamCRam + (cram_bank << 20) + (page - 0x04100000);
+	} else {
+		cps3_spr_written |= 1 << ((page >> 16) & 7);
+		mem = (UINT8 *)RamSpr + (page - 0x04000000);
+	}
 
-   }
+	Sh2MapMemory(mem, page, page | 0xffff, SH2_WRITE);
+	Sh2InvalidateCode(page, page | 0xffff);
+	return mem;
 }
 
-static void __fastcall cps3VidWriteLong(UINT32 addr, UINT32 data)
+static void __fastcall cps3TrackWriteByte(UINT32 addr, UINT8 data)
+{
+	addr &= 0xc7ffffff;
+	UINT8 * mem = cps3_track_page(addr);
+#ifdef MSB_FIRST
+	mem[addr & 0xffff] = data;
+#else
+	mem[(addr & 0xffff) ^ 3] = data;
+#endif
+}
+
+static void __fastcall cps3TrackWriteWord(UINT32 addr, UINT16 data)
+{
+	addr &= 0xc7ffffff;
+	UINT8 * mem = cps3_track_page(addr);
+#ifdef MSB_FIRST
+	*(UINT16 *)(mem + (addr & 0xffff)) = data;
+#else
+	*(UINT16 *)(mem + ((addr & 0xffff) ^ 2)) = data;
+#endif
+}
+
+static void __fastcall cps3TrackWriteLong(UINT32 addr, UINT32 data)
+{
+	addr &= 0xc7ffffff;
+	UINT8 * mem = cps3_track_page(addr);
+	*(UINT32 *)(mem + (addr & 0xffff)) = data;
+}
+
+// char ram pages a background dma is writing, the first access waits for it
+static UINT8 __fastcall cps3CRamStallReadByte(UINT32 addr)
+{
+	addr &= 0xc7ffffff;
+	cps3_chardma_finish();
+	UINT8 * mem = (UINT8 *)RamCRam + (cram_bank << 20);
+#ifdef MSB_FIRST
+	return mem[addr & 0xfffff];
+#else
+	return mem[(addr & 0xfffff) ^ 3];
+#endif
+}
+
+static UINT16 __fastcall cps3CRamStallReadWord(UINT32 addr)
+{
+	addr &= 0xc7ffffff;
+	cps3_chardma_finish();
+	UINT8 * mem = (UINT8 *)RamCRam + (cram_bank << 20);
+#ifdef MSB_FIRST
+	return *(UINT16 *)(mem + (addr & 0xfffff));
+#else
+	return *(UINT16 *)(mem + ((addr & 0xfffff) ^ 2));
+#endif
+}
+
+static UINT32 __fastcall cps3CRamStallReadLong(UINT32 addr)
 {
 	addr &= 0xc7ffffff;
+	cps3_chardma_finish();
+	UINT8 * mem = (UINT8 *)RamCRam + (cram_bank << 20);
+	return *(UINT32 *)(mem + (addr & 0xfffff));
+}
+
+static void __fastcall cps3CRamStallWriteByte(UINT32 addr, UINT8 data)
+{
+	cps3_chardma_finish();
+	cps3TrackWriteByte(addr, data);
+}
+
+static void __fastcall cps3CRamStallWriteWord(UINT32 addr, UINT16 data)
+{
+	cps3_chardma_finish();
+	cps3TrackWriteWord(addr, data);
+}
+
+static void __fastcall cps3CRamStallWriteLong(UINT32 addr, UINT32 data)
+{
+	cps3_chardma_finish();
+	cps3TrackWriteLong(addr, data);
+}
+
+// handler 6 only exists while a background dma has char ram pages on it
+static void cps3_chardma_stall(INT32 on)
+{
+	Sh2SetReadByteHandler (6, on ? cps3CRamStallReadByte  : NULL);
+	Sh2SetReadWordHandler (6, on ? cps3CRamStallReadWord  : NULL);
+	Sh2SetReadLongHandler (6, on ? cps3CRamStallReadLong  : NULL);
+	Sh2SetWriteByteHandler(6, on ? cps3CRamStallWriteByte : NULL);
+	Sh2SetWriteWordHandler(6, on ? cps3CRamStallWriteWord : NULL);
+	Sh2SetWriteLongHandler(6, on ? cps3CRamStallWriteLong : NULL);
+}
+
+// memory was replaced behind the trackers back, resync everything
+static void cps3_track_reset(void)
+{
+	cps3_dirty        = CPS3_DIRTY_ALL;
+	cps3_spr_written  = 0xff;
+	cps3_ss_written   = 1;
+	cps3_cram_written = 1;
+	memset(cps3_cram_pages, 1, sizeof(cps3_cram_pages));
+	cps3_track_arm();
 }
 
+// the poll loop of each game, caught on its read when the sh2 core cannot
+// skip it by itself
 static UINT8 __fastcall cps3RamReadByte(UINT32 addr)
 {
 	if (addr == cps3_speedup_ram_address )
@@ -970,24 +1403,28 @@ static void Cps3PatchRegion(void)
 
 static INT32 Cps3Reset(void)
 {
+   Sh2Open(0);
+   cps3_chardma_finish();
+   cps3_chardma_irq = 0;
+
    // re-map cram_bank
    cram_bank = 0;
    Sh2MapMemory((UINT8 *)RamCRam, 0x04100000, 0x041fffff, SH2_RAM);
+   cps3_track_reset();
 
    Cps3PatchRegion();
 
-   // [CD-ROM not emulated] All CHD drivers cause a Guru Meditation with the normal bios boot.
-   if(!BurnDrvGetHardwareCode() & HARDWARE_CAPCOM_CPS3_NO_CD) // normal boot
-      Sh2Reset();
+   // [CD-ROM not emulated] All CHD drivers cause a Guru Meditation with the normal bios boot,
+   // so NO_CD and CD sets alike fast boot from the game flash.
+   if (cps3_isSpecial)
+      Sh2Reset( *(UINT32 *)(RomGame + 0), *(UINT32 *)(RomGame + 4) );
    else
-   {
-      // fast boot
-      if (cps3_isSpecial)
-         Sh2Reset( *(UINT32 *)(RomGame + 0), *(UINT32 *)(RomGame + 4) );
-      else
-         Sh2Reset( *(UINT32 *)(RomGame_D + 0), *(UINT32 *)(RomGame_D + 4) );
-      Sh2SetVBR(0x06000000);
-   }
+      Sh2Reset( *(UINT32 *)(RomGame_D + 0), *(UINT32 *)(RomGame_D + 4) );
+   Sh2SetVBR(0x06000000);
+
+   if (cps3_rom_test > 0)
+      cps3_rom_test = 0;
+   cps3_rom_map();
 
    if (cps3_dip & 0x80)
    {
@@ -1165,37 +1602,36 @@ INT32 cps3Init(void)
 		Sh2SetWriteWordHandler(1, cps3C0WriteWord);
 		Sh2SetWriteLongHandler(1, cps3C0WriteLong);
 
-		if( !BurnDrvGetHardwareCode() & HARDWARE_CAPCOM_CPS3_NO_CD ) 
-		{		
-			if (cps3_isSpecial)
-         {
-				Sh2MapMemory(RomGame,	0x06000000, 0x06ffffff, SH2_READ);	// Decrypted SH2 Code
-				Sh2MapMemory(RomGame_D,	0x06000000, 0x06ffffff, SH2_FETCH);	// Decrypted SH2 Code
-			}
-         else
-				Sh2MapMemory(RomGame_D,	0x06000000, 0x06ffffff, SH2_READ | SH2_FETCH);	// Decrypted SH2 Code
+		// every set boots from the flash (see Cps3Reset), reads are mapped by cps3_rom_map()
+		Sh2MapMemory(RomGame_D,		0x06000000, 0x06ffffff, SH2_FETCH);	// Decrypted SH2 Code
+		Sh2MapHandler(2,		      0x06000000, 0x06ffffff, SH2_READ | SH2_WRITE);
+
+		if (cps3_isSpecial)
+		{
+			Sh2SetReadByteHandler (2, cps3RomReadByteSpe);
+			Sh2SetReadWordHandler (2, cps3RomReadWordSpe);
+			Sh2SetReadLongHandler (2, cps3RomReadLongSpe);
 		}
-      else
-      {
-			Sh2MapMemory(RomGame_D,		0x06000000, 0x06ffffff, SH2_FETCH);	// Decrypted SH2 Code
-			Sh2MapHandler(2,		      0x06000000, 0x06ffffff, SH2_READ | SH2_WRITE);
+		else
+		{
+			Sh2SetReadByteHandler (2, cps3RomReadByte);
+			Sh2SetReadWordHandler (2, cps3RomReadWord);
+			Sh2SetReadLongHandler (2, cps3RomReadLong);
+		}
+		Sh2SetWriteByteHandler(2, cps3RomWriteByte);
+		Sh2SetWriteWordHandler(2, cps3RomWriteWord);
+		Sh2SetWriteLongHandler(2, cps3RomWriteLong);
 
-			if (cps3_isSpecial)
-         {
-				Sh2SetReadByteHandler (2, cps3RomReadByteSpe);
-				Sh2SetReadWordHandler (2, cps3RomReadWordSpe);
-				Sh2SetReadLongHandler (2, cps3RomReadLongSpe);
-			}
-         else
-         {
-				Sh2SetReadByteHandler (2, cps3RomReadByte);
-				Sh2SetReadWordHandler (2, cps3RomReadWord);
-				Sh2SetReadLongHandler (2, cps3RomReadLong);
-			}
-         Sh2SetWriteByteHandler(2, cps3RomWriteByte);
-         Sh2SetWriteWordHandler(2, cps3RomWriteWord);
-         Sh2SetWriteLongHandler(2, cps3RomWriteLong);
+		// the ROM tests read the encrypted data, catch the cpu entering them
+		cps3_rom_test = 0;
+		if (!cps3_isSpecial)
+		{
+			if (cps3_bios_test_hack && Sh2SetPcWatch(0, cps3_bios_test_hack, cps3_rom_test_hit))
+				cps3_rom_test = -1;
+			if (cps3_game_test_hack && Sh2SetPcWatch(1, cps3_game_test_hack, cps3_rom_test_hit))
+				cps3_rom_test = -1;
 		}
+		cps3_rom_handler = -1;
 
 		Sh2MapHandler(3, 0x040e0000, 0x040e02ff, SH2_RAM);
 		Sh2SetReadByteHandler (3, cps3SndReadByte);
@@ -1215,18 +1651,34 @@ INT32 cps3Init(void)
 		Sh2SetWriteWordHandler(4, cps3VidWriteWord);
 		Sh2SetWriteLongHandler(4, cps3VidWriteLong);
 
-#ifdef SPEED_HACK
-		// install speedup read handler
-		Sh2MapHandler(5, 0x02000000 | (cps3_speedup_ram_address & 0x030000),
-				0x0200ffff | (cps3_speedup_ram_address & 0x030000), SH2_READ);
-		Sh2SetReadByteHandler (5, cps3RamReadByte);
-		Sh2SetReadWordHandler (5, cps3RamReadWord);
-		Sh2SetReadLongHandler (5, cps3RamReadLong);
-#endif
+		Sh2SetWriteByteHandler(5, cps3TrackWriteByte);
+		Sh2SetWriteWordHandler(5, cps3TrackWriteWord);
+		Sh2SetWriteLongHandler(5, cps3TrackWriteLong);
+
+		// the core finds the poll loops by itself, the known one is checked
+		// against what it finds and skipped if it is missed. Without the
+		// block cache a read handler over that part of main ram catches it
+		if (cps3_speedup_code_address && Sh2SetIdleHint(cps3_speedup_code_address, cps3_speedup_ram_address))
+		{
+			Sh2MapHandler(7, 0x02000000 | (cps3_speedup_ram_address & 0x030000),
+					0x0200ffff | (cps3_speedup_ram_address & 0x030000), SH2_READ);
+			Sh2SetReadByteHandler (7, cps3RamReadByte);
+			Sh2SetReadWordHandler (7, cps3RamReadWord);
+			Sh2SetReadLongHandler (7, cps3RamReadLong);
+		}
 	}
 
 	BurnDrvGetVisibleSize(&cps3_gfx_width, &cps3_gfx_height);	
 	RamScreen	+= (512 * 2) * 16 + 16; // safe draw	
+
+	cps3_pipelined = 0;
+	DrawCRam	= RamCRam;
+	DrawPal		= Cps3CurPal;
+
+	cps3_palette_lut();
+	cps3_pal_check = 0;
+	memset(cps3_pal_dirty, 0, sizeof(cps3_pal_dirty));
+
 	cps3SndInit(RomUser);
 	cps3SndSetRoute(BURN_SND_CPS3SND_ROUTE_1, 1.00, BURN_SND_ROUTE_LEFT);
 	cps3SndSetRoute(BURN_SND_CPS3SND_ROUTE_2, 1.00, BURN_SND_ROUTE_RIGHT);
@@ -1243,6 +1695,12 @@ INT32 cps3Init(void)
 
 INT32 cps3Exit(void)
 {
+	cps3_chardma_finish();
+	cps3_dma_cache_set(0);
+	BurnThreadWait();
+	BurnFree(CRamDrawn);
+	cps3_pipelined = 0;
+
 	Sh2Exit();
 #ifdef WII_VM
 	RomUser = NULL;
@@ -1256,299 +1714,60 @@ INT32 cps3Exit(void)
 	return 0;
 }
 
+#include "cps3_row.inc"
+
+template <typename T>
 static void cps3_drawgfxzoom_0(UINT32 code, UINT32 pal, INT32 flipx, INT32 flipy, INT32 x, INT32 y)
 {
 	if ((x > (cps3_gfx_width - 8)) || (y > (cps3_gfx_height - 8))) return;
-	UINT16 * dst   = (UINT16 *) pBurnDraw;
-	UINT8 * src    = (UINT8 *)RamSS;
-	UINT16 * color = Cps3CurPal + (pal << 4);
+	T * dst        = (T *) DrawDest;
+	UINT8 * src    = (UINT8 *)SSDrawn;
+	T * color      = (T *) DrawPal + (pal << 4);
+	INT32 pitch    = cps3_gfx_width;
 	dst           += (y * cps3_gfx_width + x);
 	src           += code * 64;
-	
-	if ( flipy )
-	{
-		dst += cps3_gfx_width * 7;
-#ifdef MSB_FIRST
-		if ( flipx )
-			for(int i=0; i<8; i++, dst-= cps3_gfx_width, src += 8)
-         {
-				if ( src[ 1] & 0xf ) dst[7] = color [ src[ 1] & 0xf ];
-				if ( src[ 1] >>  4 ) dst[6] = color [ src[ 1] >>  4 ];
-				if ( src[ 3] & 0xf ) dst[5] = color [ src[ 3] & 0xf ];
-				if ( src[ 3] >>  4 ) dst[4] = color [ src[ 3] >>  4 ];
-				if ( src[ 5] & 0xf ) dst[3] = color [ src[ 5] & 0xf ];
-				if ( src[ 5] >>  4 ) dst[2] = color [ src[ 5] >>  4 ];
-				if ( src[ 7] & 0xf ) dst[1] = color [ src[ 7] & 0xf ];
-				if ( src[ 7] >>  4 ) dst[0] = color [ src[ 7] >>  4 ];
-			}
-		else
-			for(int i=0; i<8; i++, dst-= cps3_gfx_width, src += 8)
-         {
-				if ( src[ 1] & 0xf ) dst[0] = color [ src[ 1] & 0xf ];
-				if ( src[ 1] >>  4 ) dst[1] = color [ src[ 1] >>  4 ];
-				if ( src[ 3] & 0xf ) dst[2] = color [ src[ 3] & 0xf ];
-				if ( src[ 3] >>  4 ) dst[3] = color [ src[ 3] >>  4 ];
-				if ( src[ 5] & 0xf ) dst[4] = color [ src[ 5] & 0xf ];
-				if ( src[ 5] >>  4 ) dst[5] = color [ src[ 5] >>  4 ];
-				if ( src[ 7] & 0xf ) dst[6] = color [ src[ 7] & 0xf ];
-				if ( src[ 7] >>  4 ) dst[7] = color [ src[ 7] >>  4 ];
-			}
 
-	} else {
-		if ( flipx )
-			for(int i=0; i<8; i++, dst+= cps3_gfx_width, src += 8) {
-				if ( src[ 1] & 0xf ) dst[7] = color [ src[ 1] & 0xf ];
-				if ( src[ 1] >>  4 ) dst[6] = color [ src[ 1] >>  4 ];
-				if ( src[ 3] & 0xf ) dst[5] = color [ src[ 3] & 0xf ];
-				if ( src[ 3] >>  4 ) dst[4] = color [ src[ 3] >>  4 ];
-				if ( src[ 5] & 0xf ) dst[3] = color [ src[ 5] & 0xf ];
-				if ( src[ 5] >>  4 ) dst[2] = color [ src[ 5] >>  4 ];
-				if ( src[ 7] & 0xf ) dst[1] = color [ src[ 7] & 0xf ];
-				if ( src[ 7] >>  4 ) dst[0] = color [ src[ 7] >>  4 ];
-			}
-		else
-			for(int i=0; i<8; i++, dst+= cps3_gfx_width, src += 8) {
-				if ( src[ 1 ] & 0xf ) dst[0] = color [ src[ 1 ] & 0xf ];
-				if ( src[ 1 ] >>  4 ) dst[1] = color [ src[ 1 ] >>  4 ];
-				if ( src[ 3 ] & 0xf ) dst[2] = color [ src[ 3 ] & 0xf ];
-				if ( src[ 3 ] >>  4 ) dst[3] = color [ src[ 3 ] >>  4 ];
-				if ( src[ 5 ] & 0xf ) dst[4] = color [ src[ 5 ] & 0xf ];
-				if ( src[ 5 ] >>  4 ) dst[5] = color [ src[ 5 ] >>  4 ];
-				if ( src[ 7 ] & 0xf ) dst[6] = color [ src[ 7 ] & 0xf ];
-				if ( src[ 7 ] >>  4 ) dst[7] = color [ src[ 7 ] >>  4 ];
-			}
+	if ( flipy )
+   {
+		dst  += pitch * 7;
+		pitch = -pitch;
 	}
-#else
-      if ( flipx )
-         for(INT32 i=0; i<8; i++, dst-= cps3_gfx_width, src += 8) {
-            if ( src[ 2] & 0xf ) dst[7] = color [ src[ 2] & 0xf ];
-            if ( src[ 2] >>  4 ) dst[6] = color [ src[ 2] >>  4 ];
-            if ( src[ 0] & 0xf ) dst[5] = color [ src[ 0] & 0xf ];
-            if ( src[ 0] >>  4 ) dst[4] = color [ src[ 0] >>  4 ];
-            if ( src[ 6] & 0xf ) dst[3] = color [ src[ 6] & 0xf ];
-            if ( src[ 6] >>  4 ) dst[2] = color [ src[ 6] >>  4 ];
-            if ( src[ 4] & 0xf ) dst[1] = color [ src[ 4] & 0xf ];
-            if ( src[ 4] >>  4 ) dst[0] = color [ src[ 4] >>  4 ];
-         }
-      else
-         for(INT32 i=0; i<8; i++, dst-= cps3_gfx_width, src += 8) {
-            if ( src[ 2] & 0xf ) dst[0] = color [ src[ 2] & 0xf ];
-            if ( src[ 2] >>  4 ) dst[1] = color [ src[ 2] >>  4 ];
-            if ( src[ 0] & 0xf ) dst[2] = color [ src[ 0] & 0xf ];
-            if ( src[ 0] >>  4 ) dst[3] = color [ src[ 0] >>  4 ];
-            if ( src[ 6] & 0xf ) dst[4] = color [ src[ 6] & 0xf ];
-            if ( src[ 6] >>  4 ) dst[5] = color [ src[ 6] >>  4 ];
-            if ( src[ 4] & 0xf ) dst[6] = color [ src[ 4] & 0xf ];
-            if ( src[ 4] >>  4 ) dst[7] = color [ src[ 4] >>  4 ];
-         }
 
-   } else {
-      if ( flipx )
-         for(INT32 i=0; i<8; i++, dst+= cps3_gfx_width, src += 8) {
-            if ( src[ 2] & 0xf ) dst[7] = color [ src[ 2] & 0xf ];
-            if ( src[ 2] >>  4 ) dst[6] = color [ src[ 2] >>  4 ];
-            if ( src[ 0] & 0xf ) dst[5] = color [ src[ 0] & 0xf ];
-            if ( src[ 0] >>  4 ) dst[4] = color [ src[ 0] >>  4 ];
-            if ( src[ 6] & 0xf ) dst[3] = color [ src[ 6] & 0xf ];
-            if ( src[ 6] >>  4 ) dst[2] = color [ src[ 6] >>  4 ];
-            if ( src[ 4] & 0xf ) dst[1] = color [ src[ 4] & 0xf ];
-            if ( src[ 4] >>  4 ) dst[0] = color [ src[ 4] >>  4 ];
-         }
-      else
-         for(INT32 i=0; i<8; i++, dst+= cps3_gfx_width, src += 8) {
-            if ( src[ 2] & 0xf ) dst[0] = color [ src[ 2] & 0xf ];
-            if ( src[ 2] >>  4 ) dst[1] = color [ src[ 2] >>  4 ];
-            if ( src[ 0] & 0xf ) dst[2] = color [ src[ 0] & 0xf ];
-            if ( src[ 0] >>  4 ) dst[3] = color [ src[ 0] >>  4 ];
-            if ( src[ 6] & 0xf ) dst[4] = color [ src[ 6] & 0xf ];
-            if ( src[ 6] >>  4 ) dst[5] = color [ src[ 6] >>  4 ];
-            if ( src[ 4] & 0xf ) dst[6] = color [ src[ 4] & 0xf ];
-            if ( src[ 4] >>  4 ) dst[7] = color [ src[ 4] >>  4 ];
-         }
-   }
+	for (INT32 i = 0; i < 8; i++, dst += pitch, src += 8)
+   {
+#ifdef MSB_FIRST
+		UINT32 bits = src[1] | (src[3] << 8) | (src[5] << 16) | ((UINT32)src[7] << 24);
+#else
+		UINT32 bits = src[2] | (src[0] << 8) | (src[6] << 16) | ((UINT32)src[4] << 24);
 #endif
+		cps3_draw_row8(dst, bits, color, flipx);
+	}
 }
 
 static void cps3_drawgfxzoom_1(UINT32 code, UINT32 pal, INT32 flipx, INT32 flipy, INT32 x, INT32 y, INT32 drawline)
 {
 	UINT32 * dst = RamScreen;
-	UINT8 * src  = (UINT8 *) RamCRam;
+	UINT8 * src  = (UINT8 *) DrawCRam;
 	dst         += (drawline * 1024 + x);
 
-#if BE_GFX
 	if ( flipy )
-   {
 		src += code * 256 + 16 * (15 - (drawline - y));
-		if ( flipx )
-      {
-			if ( src[ 0] ) dst[15] = src[ 0] | pal;
-			if ( src[ 1] ) dst[14] = src[ 1] | pal;
-			if ( src[ 2] ) dst[13] = src[ 2] | pal;
-			if ( src[ 3] ) dst[12] = src[ 3] | pal;
-			if ( src[ 4] ) dst[11] = src[ 4] | pal;
-			if ( src[ 5] ) dst[10] = src[ 5] | pal;
-			if ( src[ 6] ) dst[ 9] = src[ 6] | pal;
-			if ( src[ 7] ) dst[ 8] = src[ 7] | pal;
-			if ( src[ 8] ) dst[ 7] = src[ 8] | pal;
-			if ( src[ 9] ) dst[ 6] = src[ 9] | pal;
-			if ( src[10] ) dst[ 5] = src[10] | pal;
-			if ( src[11] ) dst[ 4] = src[11] | pal;
-			if ( src[12] ) dst[ 3] = src[12] | pal;
-			if ( src[13] ) dst[ 2] = src[13] | pal;
-			if ( src[14] ) dst[ 1] = src[14] | pal;
-			if ( src[15] ) dst[ 0] = src[15] | pal;
-		}
-      else
-      {
-			if ( src[ 0] ) dst[ 0] = src[ 0] | pal;
-			if ( src[ 1] ) dst[ 1] = src[ 1] | pal;
-			if ( src[ 2] ) dst[ 2] = src[ 2] | pal;
-			if ( src[ 3] ) dst[ 3] = src[ 3] | pal;
-			if ( src[ 4] ) dst[ 4] = src[ 4] | pal;
-			if ( src[ 5] ) dst[ 5] = src[ 5] | pal;
-			if ( src[ 6] ) dst[ 6] = src[ 6] | pal;
-			if ( src[ 7] ) dst[ 7] = src[ 7] | pal;
-			if ( src[ 8] ) dst[ 8] = src[ 8] | pal;
-			if ( src[ 9] ) dst[ 9] = src[ 9] | pal;
-			if ( src[10] ) dst[10] = src[10] | pal;
-			if ( src[11] ) dst[11] = src[11] | pal;
-			if ( src[12] ) dst[12] = src[12] | pal;
-			if ( src[13] ) dst[13] = src[13] | pal;
-			if ( src[14] ) dst[14] = src[14] | pal;
-			if ( src[15] ) dst[15] = src[15] | pal;
-		}
-	}
-   else
-   {
-		src += code * 256 + 16 * (drawline - y);
-		if ( flipx ) {
-			if ( src[ 0] ) dst[15] = src[ 0] | pal;
-			if ( src[ 1] ) dst[14] = src[ 1] | pal;
-			if ( src[ 2] ) dst[13] = src[ 2] | pal;
-			if ( src[ 3] ) dst[12] = src[ 3] | pal;
-			if ( src[ 4] ) dst[11] = src[ 4] | pal;
-			if ( src[ 5] ) dst[10] = src[ 5] | pal;
-			if ( src[ 6] ) dst[ 9] = src[ 6] | pal;
-			if ( src[ 7] ) dst[ 8] = src[ 7] | pal;
-			if ( src[ 8] ) dst[ 7] = src[ 8] | pal;
-			if ( src[ 9] ) dst[ 6] = src[ 9] | pal;
-			if ( src[10] ) dst[ 5] = src[10] | pal;
-			if ( src[11] ) dst[ 4] = src[11] | pal;
-			if ( src[12] ) dst[ 3] = src[12] | pal;
-			if ( src[13] ) dst[ 2] = src[13] | pal;
-			if ( src[14] ) dst[ 1] = src[14] | pal;
-			if ( src[15] ) dst[ 0] = src[15] | pal;
-		} else {
-			if ( src[ 0] ) dst[ 0] = src[ 0] | pal;
-			if ( src[ 1] ) dst[ 1] = src[ 1] | pal;
-			if ( src[ 2] ) dst[ 2] = src[ 2] | pal;
-			if ( src[ 3] ) dst[ 3] = src[ 3] | pal;
-			if ( src[ 4] ) dst[ 4] = src[ 4] | pal;
-			if ( src[ 5] ) dst[ 5] = src[ 5] | pal;
-			if ( src[ 6] ) dst[ 6] = src[ 6] | pal;
-			if ( src[ 7] ) dst[ 7] = src[ 7] | pal;
-			if ( src[ 8] ) dst[ 8] = src[ 8] | pal;
-			if ( src[ 9] ) dst[ 9] = src[ 9] | pal;
-			if ( src[10] ) dst[10] = src[10] | pal;
-			if ( src[11] ) dst[11] = src[11] | pal;
-			if ( src[12] ) dst[12] = src[12] | pal;
-			if ( src[13] ) dst[13] = src[13] | pal;
-			if ( src[14] ) dst[14] = src[14] | pal;
-			if ( src[15] ) dst[15] = src[15] | pal;
-		}
-	}
-#else
-	if ( flipy )
-   {
-		src += code * 256 + 16 * (15 - (drawline - y));
-		if ( flipx )
-      {
-			if ( src[ 3] ) dst[15] = src[ 3] | pal;
-			if ( src[ 2] ) dst[14] = src[ 2] | pal;
-			if ( src[ 1] ) dst[13] = src[ 1] | pal;
-			if ( src[ 0] ) dst[12] = src[ 0] | pal;
-			if ( src[ 7] ) dst[11] = src[ 7] | pal;
-			if ( src[ 6] ) dst[10] = src[ 6] | pal;
-			if ( src[ 5] ) dst[ 9] = src[ 5] | pal;
-			if ( src[ 4] ) dst[ 8] = src[ 4] | pal;
-			if ( src[11] ) dst[ 7] = src[11] | pal;
-			if ( src[10] ) dst[ 6] = src[10] | pal;
-			if ( src[ 9] ) dst[ 5] = src[ 9] | pal;
-			if ( src[ 8] ) dst[ 4] = src[ 8] | pal;
-			if ( src[15] ) dst[ 3] = src[15] | pal;
-			if ( src[14] ) dst[ 2] = src[14] | pal;
-			if ( src[13] ) dst[ 1] = src[13] | pal;
-			if ( src[12] ) dst[ 0] = src[12] | pal;
-		}
-      else
-      {
-			if ( src[ 3] ) dst[ 0] = src[ 3] | pal;
-			if ( src[ 2] ) dst[ 1] = src[ 2] | pal;
-			if ( src[ 1] ) dst[ 2] = src[ 1] | pal;
-			if ( src[ 0] ) dst[ 3] = src[ 0] | pal;
-			if ( src[ 7] ) dst[ 4] = src[ 7] | pal;
-			if ( src[ 6] ) dst[ 5] = src[ 6] | pal;
-			if ( src[ 5] ) dst[ 6] = src[ 5] | pal;
-			if ( src[ 4] ) dst[ 7] = src[ 4] | pal;
-			if ( src[11] ) dst[ 8] = src[11] | pal;
-			if ( src[10] ) dst[ 9] = src[10] | pal;
-			if ( src[ 9] ) dst[10] = src[ 9] | pal;
-			if ( src[ 8] ) dst[11] = src[ 8] | pal;
-			if ( src[15] ) dst[12] = src[15] | pal;
-			if ( src[14] ) dst[13] = src[14] | pal;
-			if ( src[13] ) dst[14] = src[13] | pal;
-			if ( src[12] ) dst[15] = src[12] | pal;
-		}
-	}
-   else
-   {
+	else
 		src += code * 256 + 16 * (drawline - y);
-		if ( flipx )
-      {
-			if ( src[ 3] ) dst[15] = src[ 3] | pal;
-			if ( src[ 2] ) dst[14] = src[ 2] | pal;
-			if ( src[ 1] ) dst[13] = src[ 1] | pal;
-			if ( src[ 0] ) dst[12] = src[ 0] | pal;
-			if ( src[ 7] ) dst[11] = src[ 7] | pal;
-			if ( src[ 6] ) dst[10] = src[ 6] | pal;
-			if ( src[ 5] ) dst[ 9] = src[ 5] | pal;
-			if ( src[ 4] ) dst[ 8] = src[ 4] | pal;
-			if ( src[11] ) dst[ 7] = src[11] | pal;
-			if ( src[10] ) dst[ 6] = src[10] | pal;
-			if ( src[ 9] ) dst[ 5] = src[ 9] | pal;
-			if ( src[ 8] ) dst[ 4] = src[ 8] | pal;
-			if ( src[15] ) dst[ 3] = src[15] | pal;
-			if ( src[14] ) dst[ 2] = src[14] | pal;
-			if ( src[13] ) dst[ 1] = src[13] | pal;
-			if ( src[12] ) dst[ 0] = src[12] | pal;
-		}
-      else
-      {
-			if ( src[ 3] ) dst[ 0] = src[ 3] | pal;
-			if ( src[ 2] ) dst[ 1] = src[ 2] | pal;
-			if ( src[ 1] ) dst[ 2] = src[ 1] | pal;
-			if ( src[ 0] ) dst[ 3] = src[ 0] | pal;
-			if ( src[ 7] ) dst[ 4] = src[ 7] | pal;
-			if ( src[ 6] ) dst[ 5] = src[ 6] | pal;
-			if ( src[ 5] ) dst[ 6] = src[ 5] | pal;
-			if ( src[ 4] ) dst[ 7] = src[ 4] | pal;
-			if ( src[11] ) dst[ 8] = src[11] | pal;
-			if ( src[10] ) dst[ 9] = src[10] | pal;
-			if ( src[ 9] ) dst[10] = src[ 9] | pal;
-			if ( src[ 8] ) dst[11] = src[ 8] | pal;
-			if ( src[15] ) dst[12] = src[15] | pal;
-			if ( src[14] ) dst[13] = src[14] | pal;
-			if ( src[13] ) dst[14] = src[13] | pal;
-			if ( src[12] ) dst[15] = src[12] | pal;
-		}
-	}
 
+#if BE_GFX
+	cps3_draw_row16(dst, src, pal, flipx);
+#else
+	for (INT32 i = 0; i < 16; i++)
+		if ( src[i ^ 3] ) dst[flipx ? 15 - i : i] = src[i ^ 3] | pal;
 #endif
 }
 
-static void cps3_drawgfxzoom_2(UINT32 code, UINT32 pal, INT32 flipx, INT32 flipy, INT32 sx, INT32 sy, INT32 scalex, INT32 scaley, INT32 alpha)
+// rows outside miny - maxy (inclusive) are clipped, a band renderer draws
+// one band of the screen per call
+static void cps3_drawgfxzoom_2(UINT32 code, UINT32 pal, INT32 flipx, INT32 flipy, INT32 sx, INT32 sy, INT32 scalex, INT32 scaley, INT32 alpha, INT32 miny, INT32 maxy)
 {
-	UINT8 * source_base        = (UINT8 *) RamCRam + code * 256;
+	UINT8 * source_base        = (UINT8 *) DrawCRam + code * 256;
 	INT32 sprite_screen_height = (scaley * 16 + 0x8000) >> 16;
 	INT32 sprite_screen_width  = (scalex * 16 + 0x8000) >> 16;	
 	if (sprite_screen_width && sprite_screen_height)
@@ -1582,9 +1801,9 @@ static void cps3_drawgfxzoom_2(UINT32 code, UINT32 pal, INT32 flipx, INT32 flipy
 				sx += pixels;
 				x_index_base += pixels*dx;
 			}
-			if( sy < 0 ) /* clip top */
+			if( sy < miny ) /* clip top */
 			{
-				INT32 pixels = 0-sy;
+				INT32 pixels = miny-sy;
 				sy += pixels;
 				y_index += pixels*dy;
 			}
@@ -1593,82 +1812,76 @@ static void cps3_drawgfxzoom_2(UINT32 code, UINT32 pal, INT32 flipx, INT32 flipy
 				INT32 pixels = ex-cps3_gfx_max_x-1;
 				ex -= pixels;
 			}
-			if( ey > cps3_gfx_max_y+1 ) /* clip bottom */
+			if( ey > maxy+1 ) /* clip bottom */
 			{
-				INT32 pixels = ey-cps3_gfx_max_y-1;
+				INT32 pixels = ey-maxy-1;
 				ey -= pixels;
 			}
 		}
 
-		if( ex > sx )
+		if( ex > sx && ey > sy )
       {
-			switch( alpha )
-         {
-            case 0:
-               for( INT32 y=sy; y<ey; y++ )
-               {
-                  UINT8 * source = source_base + (y_index>>16) * 16;
-                  UINT32 * dest  = RamScreen + y * 512 * 2;
-                  INT32 x_index  = x_index_base;
-                  for(INT32 x=sx; x<ex; x++ )
-                  {
+			// one source column per screen column, and the source row gathered
+			// through it only when (y_index>>16) changes; unscaled sprites
+			// read the source row in place
+			UINT8 xtab[1024], row[1024];
+			const UINT8 * pix = row;
+			INT32 w       = ex - sx;
+			INT32 x_index = x_index_base;
+			INT32 last    = -1;
 #if BE_GFX
-                     UINT8 c    = source[ (x_index>>16) ];
+			INT32 direct  = (dx == 0x10000);
 #else
-                     UINT8 c    = source[ (x_index>>16) ^ 3 ];
+			INT32 direct  = 0;
 #endif
-                     if( c )
-                        dest[x] = pal | c;
-                     x_index   += dx;
-                  }
-                  y_index += dy;
-               }
-               break;
-            case 6:
-               for( INT32 y=sy; y<ey; y++ )
-               {
-                  UINT8 * source = source_base + (y_index>>16) * 16;
-                  UINT32 * dest = RamScreen + y * 512 * 2;
-                  INT32 x_index = x_index_base;
-                  for(INT32 x=sx; x<ex; x++ )
-                  {
-#if BE_GFX
-                     UINT8 c  = source[ (x_index>>16)];
-#else
-                     UINT8 c  = source[ (x_index>>16) ^ 3 ];
-#endif
-                     dest[x] |= ((c&0x0000f) << 13);
-                     x_index += dx;
-                  }
-                  y_index += dy;
-               }
-               break;
-            case 8:
-               for( INT32 y=sy; y<ey; y++ )
-               {
-                  UINT8 * source = source_base + (y_index>>16) * 16;
-                  UINT32 * dest  = RamScreen + y * 512 * 2;
-                  INT32 x_index  = x_index_base;
-                  for(INT32 x=sx; x<ex; x++ )
-                  {
+
+			for (INT32 i = 0; i < w; i++, x_index += dx)
 #if BE_GFX
-                     UINT8 c = source[ (x_index>>16) ];
+				xtab[i] = x_index >> 16;
 #else
-                     UINT8 c = source[ (x_index>>16) ^ 3 ];
+				xtab[i] = (x_index >> 16) ^ 3;
 #endif
 
-                     if (c)
-                     {
-                        dest[x] |= 0x8000;
-                        if (pal&0x10000)
-                           dest[x] |= 0x10000;
-                     }
-                     x_index += dx;
-                  }
-                  y_index += dy;
-               }
-               break;
-         }
+			for (INT32 y = sy; y < ey; y++, y_index += dy)
+         {
+				UINT32 * dest = RamScreen + y * 512 * 2 + sx;
+				INT32 i;
+
+				if (direct)
+					pix = source_base + (y_index >> 16) * 16 + xtab[0];
+				else if ((y_index >> 16) != last)
+            {
+					UINT8 * source = source_base + (y_index >> 16) * 16;
+					last = y_index >> 16;
+					for (i = 0; i < w; i++)
+						row[i] = source[xtab[i]];
+				}
+
+				switch (alpha)
+            {
+					case 0:
+						for (i = 0; i + 16 <= w; i += 16)
+							cps3_draw_row16(dest + i, pix + i, pal, 0);
+						for (; i < w; i++)
+							if (pix[i]) dest[i] = pal | pix[i];
+						break;
+					case 6:
+						for (i = 0; i + 16 <= w; i += 16)
+							cps3_shadow_row16(dest + i, pix + i);
+						for (; i < w; i++)
+							dest[i] |= (pix[i] & 0x0f) << 13;
+						break;
+					case 8:
+               {
+						UINT32 bits = 0x8000 | (pal & 0x10000);
+						for (i = 0; i + 16 <= w; i += 16)
+							cps3_alpha_row16(dest + i, pix + i, bits);
+						for (; i < w; i++)
+							if (pix[i]) dest[i] |= bits;
+						break;
+					}
+				}
+			}
 		}
 	}
 }
@@ -1692,14 +1905,14 @@ static void cps3_draw_tilemapsprite_line(INT32 drawline, UINT32 * regs )
 		INT32 scrollx     =  (regs[0]&0xffff0000)>>16;
 
 		if (linescroll_enable)
-			scrollx  += (RamSpr[linebase+((line+16-4)&0x3ff)]>>16)&0x3ff;
+			scrollx  += (SprDrawn[linebase+((line+16-4)&0x3ff)]>>16)&0x3ff;
 
 		if (drawline>cps3_gfx_max_y+4)
 			return;
 
 		for (INT32 x=0;x<(cps3_gfx_max_x/16)+2;x++)
 		{
-			UINT32 dat   = RamSpr[mapbase+((tileline&63)*64)+((x+scrollx/16)&63)];
+			UINT32 dat   = SprDrawn[mapbase+((tileline&63)*64)+((x+scrollx/16)&63)];
 			INT32 tileno = (dat & 0xffff0000)>>17;
 			INT32 colour = (dat & 0x000001ff)>>0;
 			INT32 bpp    = (dat & 0x0000200)>>9;
@@ -1714,90 +1927,138 @@ static void cps3_draw_tilemapsprite_line(INT32 drawline, UINT32 * regs )
 	}
 }
 
-static INT32 WideScreenFrameDelay = 0;
+// -- screen raster ------------------------------------------------------------
+// The sprite list is parsed once into draw commands. The commands are then
+// drawn into RamScreen in horizontal bands, on the BurnThread pool when it has
+// more than one thread. A band only writes its own lines (tilemap tiles hanging
+// off the left edge spill into unused columns of the line above), so the result
+// does not depend on the thread count.
 
-static void DrvDraw(void)
+static void cps3_draw_band(INT32 band, void * param)
 {
-	INT32 Width, Height;
-	INT32 bg_drawn[4]              = { 0, 0, 0, 0 };
+	UINT32 fsz  = *(UINT32 *)param;
+	INT32 lines = cps3_gfx_max_y + 1;
+	INT32 miny  = lines * band / cps3_band_count;
+	INT32 maxy  = lines * (band + 1) / cps3_band_count - 1;
+	INT32 last  = (band == cps3_band_count - 1);
 
-	UINT32 fullscreenzoom          = RamVReg[ 6 * 4 + 3 ] & 0xff;
-	UINT32 fullscreenzoomwidecheck = RamVReg[6 * 4 + 1];
-	
-	BurnDrvGetVisibleSize(&Width, &Height);
-	if (((fullscreenzoomwidecheck & 0xffff0000) >> 16) == 0x0265)
+	if (cps3_band_clear)
 	{
-		if (Width != 496)
+		UINT32 * pscr = RamScreen + miny * 512 * 2;
+
+		if (nBurnLayer & 1)
 		{
-			BurnDrvSetVisibleSize(496, 224);
-			BurnDrvSetAspect(16, 9);
-			Reinitialise();
-			WideScreenFrameDelay = GetCurrentFrame() + 1;
+			INT32 clrsz = (cps3_gfx_max_x + 1) * sizeof(INT32);
+			for (INT32 yy = miny; yy <= maxy; yy++, pscr += 512*2)
+				memset(pscr, 0, clrsz);
 		}
-	}
-	else
-	{
-		if (Width != 384)
+		else
 		{
-			BurnDrvSetVisibleSize(384, 224);
-			BurnDrvSetAspect(4, 3);
-			Reinitialise();
-			WideScreenFrameDelay = GetCurrentFrame() + 1;
+			INT32 endy = last ? 447 : maxy;
+			for (INT32 i = 0; i < (endy - miny + 1) * 512 * 2; i++)
+				pscr[i] = 0x20000;
 		}
 	}
-	
-	if (fullscreenzoom > 0x80)
-      fullscreenzoom = 0x80;
-	UINT32 fsz     = (fullscreenzoom << (16 - 6));
-	cps3_gfx_max_x = ((cps3_gfx_width * fsz)  >> 16) - 1;	// 384 ( 496 for SFIII2 Only)
-	cps3_gfx_max_y = ((cps3_gfx_height * fsz) >> 16) - 1;	// 224
 
-	if (nBurnLayer & 1)
+	for (INT32 i = 0; i < cps3_cmd_count; i++)
 	{
-		UINT32 * pscr = RamScreen;
-		INT32 clrsz   = (cps3_gfx_max_x + 1) * sizeof(INT32);
-		for(INT32 yy = 0; yy<=cps3_gfx_max_y; yy++, pscr += 512*2)
-			memset(pscr, 0, clrsz);
+		cps3_draw_cmd * cmd = DrawCmd + i;
+
+		if (cmd->code == 0)
+		{
+			// lines below the screen belong to the last band
+			INT32 endy  = last ? 0x7fffffff : maxy;
+			UINT32 srcy = 0;
+			for (INT32 ry = 0; ry < 224; ry++, srcy += fsz)
+				if ((INT32)(srcy >> 16) >= miny && (INT32)(srcy >> 16) <= endy)
+					cps3_draw_tilemapsprite_line(srcy >> 16, VRegDrawn + 8 + cmd->pal * 4);
+		}
+		else
+		{
+			INT32 height = (cmd->yinc * 16 + 0x8000) >> 16;
+			if (cmd->y > maxy || cmd->y + height <= miny)
+				continue;
+
+			cps3_drawgfxzoom_2(cmd->code, cmd->pal, cmd->flipx, cmd->flipy, cmd->x, cmd->y, cmd->xinc, cmd->yinc, cmd->alpha, miny, maxy);
+		}
 	}
-	else
-	{
-		Cps3CurPal[0x20000] = BurnHighCol(0xff, 0x00, 0xff, 0);
+}
+
+static void cps3_flush_cmds(UINT32 fsz)
+{
+	if (cps3_cmd_count || cps3_band_clear)
+		BurnThreadRun(cps3_draw_band, cps3_band_count, &fsz);
+
+	cps3_cmd_count  = 0;
+	cps3_band_clear = 0;
+}
+
+static void cps3_push_cmd(UINT32 fsz, UINT32 code, UINT32 pal, INT32 flipx, INT32 flipy, INT32 x, INT32 y, INT32 xinc, INT32 yinc, INT32 alpha)
+{
+	cps3_draw_cmd * cmd = DrawCmd + cps3_cmd_count++;
+
+	cmd->code  = code;
+	cmd->pal   = pal;
+	cmd->flipx = flipx;
+	cmd->flipy = flipy;
+	cmd->x     = x;
+	cmd->y     = y;
+	cmd->xinc  = xinc;
+	cmd->yinc  = yinc;
+	cmd->alpha = alpha;
+
+	// a full buffer is drawn right away, later commands still land on top
+	if (cps3_cmd_count == CPS3_MAX_CMD)
+		cps3_flush_cmds(fsz);
+}
+
+// clears RamScreen and draws the tilemaps and sprites into it
+static void DrvDrawScreen(UINT32 fsz)
+{
+	INT32 bg_drawn[4] = { 0, 0, 0, 0 };
 
-		INT32 i;
-		for (i = 0; i < 1024 * 448; i++)
-			RamScreen[i] = 0x20000;
+	if (~nBurnLayer & 1)
+   {
+		if (cps3_bpp == 4)
+			((UINT32 *)DrawPal)[0x20000] = BurnHighColSwitch(0xff, 0x00, 0xff, 0);
+		else
+			((UINT16 *)DrawPal)[0x20000] = BurnHighColSwitch(0xff, 0x00, 0xff, 0);
 	}
-	
+
+	cps3_band_count = BurnThreadCount() > 1 ? BurnThreadCount() * 4 : 1;
+	cps3_band_clear = 1;
+	cps3_cmd_count  = 0;
+
 	// Draw Sprites
 	{
 		for (INT32 i=0x00000/4;i<0x2000/4;i+=4) {
-			INT32 xpos		= (RamSpr[i+1]&0x03ff0000)>>16;
-			INT32 ypos		= (RamSpr[i+1]&0x000003ff)>>0;
-
-			INT32 gscroll		= (RamSpr[i+0]&0x70000000)>>28;
-			INT32 length		= (RamSpr[i+0]&0x01ff0000)>>14; // how many entries in the sprite table
-			UINT32 start		= (RamSpr[i+0]&0x00007ff0)>>4;
-
-			INT32 whichbpp		= (RamSpr[i+2]&0x40000000)>>30; // not 100% sure if this is right, jojo title / characters
-			INT32 whichpal		= (RamSpr[i+2]&0x20000000)>>29;
-			INT32 global_xflip	= (RamSpr[i+2]&0x10000000)>>28;
-			INT32 global_yflip	= (RamSpr[i+2]&0x08000000)>>27;
-			INT32 global_alpha	= (RamSpr[i+2]&0x04000000)>>26; // alpha / shadow? set on sfiii2 shadows, and big black image in jojo intro
-			INT32 global_bpp	= (RamSpr[i+2]&0x02000000)>>25;
-			INT32 global_pal	= (RamSpr[i+2]&0x01ff0000)>>16;
-
-			INT32 gscrollx		= (RamVReg[gscroll]&0x03ff0000)>>16;
-			INT32 gscrolly		= (RamVReg[gscroll]&0x000003ff)>>0;
+			INT32 xpos		= (SprDrawn[i+1]&0x03ff0000)>>16;
+			INT32 ypos		= (SprDrawn[i+1]&0x000003ff)>>0;
+
+			INT32 gscroll		= (SprDrawn[i+0]&0x70000000)>>28;
+			INT32 length		= (SprDrawn[i+0]&0x01ff0000)>>14; // how many entries in the sprite table
+			UINT32 start		= (SprDrawn[i+0]&0x00007ff0)>>4;
+
+			INT32 whichbpp		= (SprDrawn[i+2]&0x40000000)>>30; // not 100% sure if this is right, jojo title / characters
+			INT32 whichpal		= (SprDrawn[i+2]&0x20000000)>>29;
+			INT32 global_xflip	= (SprDrawn[i+2]&0x10000000)>>28;
+			INT32 global_yflip	= (SprDrawn[i+2]&0x08000000)>>27;
+			INT32 global_alpha	= (SprDrawn[i+2]&0x04000000)>>26; // alpha / shadow? set on sfiii2 shadows, and big black image in jojo intro
+			INT32 global_bpp	= (SprDrawn[i+2]&0x02000000)>>25;
+			INT32 global_pal	= (SprDrawn[i+2]&0x01ff0000)>>16;
+
+			INT32 gscrollx		= (VRegDrawn[gscroll]&0x03ff0000)>>16;
+			INT32 gscrolly		= (VRegDrawn[gscroll]&0x000003ff)>>0;
 			
 			start = (start * 0x100) >> 2;
 
-			if ((RamSpr[i+0]&0xf0000000) == 0x80000000) break;	
+			if ((SprDrawn[i+0]&0xf0000000) == 0x80000000) break;	
 		
 			for (INT32 j=0; j<length; j+=4) {
 				
-				UINT32 value1 = (RamSpr[start+j+0]);
-				UINT32 value2 = (RamSpr[start+j+1]);
-				UINT32 value3 = (RamSpr[start+j+2]);
+				UINT32 value1 = (SprDrawn[start+j+0]);
+				UINT32 value2 = (SprDrawn[start+j+1]);
+				UINT32 value3 = (SprDrawn[start+j+2]);
 				UINT32 tileno = (value1&0xfffe0000)>>17;
 				INT32 count;
 				INT32 xpos2 = (value2 & 0x03ff0000)>>16;
@@ -1826,7 +2087,6 @@ static void DrvDraw(void)
 					{
 						INT32 tilemapnum = ((value3 & 0x00000030)>>4);
 						INT32 height     = (value3 & 0x7f000000)>>24;
-                  UINT32 *regs     = RamVReg + 8 + tilemapnum * 4;
 						INT32 endline    = value2;
 						INT32 startline  = endline - height;
 
@@ -1834,11 +2094,7 @@ static void DrvDraw(void)
 						endline         &= 0x3ff;
 
 						if (bg_drawn[tilemapnum]==0)
-						{
-							UINT32 srcy = 0;
-							for (INT32 ry = 0; ry < 224; ry++, srcy += fsz)
-								cps3_draw_tilemapsprite_line( srcy >> 16, regs );
-						}
+							cps3_push_cmd(fsz, 0, tilemapnum, 0, 0, 0, 0, 0, 0, 0);
 
 						bg_drawn[tilemapnum] = 1;
 					}
@@ -1927,10 +2183,10 @@ static void DrvDraw(void)
                                  if ( global_alpha && (global_pal & 0x100))
                                     actualpal &= 0x0ffff;
 
-                                 cps3_drawgfxzoom_2(realtileno,actualpal,flipx,flipy,current_xpos,current_ypos,xinc,yinc, color_granularity);
+                                 cps3_push_cmd(fsz,realtileno,actualpal,flipx,flipy,current_xpos,current_ypos,xinc,yinc, color_granularity);
 
                               } else {
-                                 cps3_drawgfxzoom_2(realtileno,actualpal,flipx,flipy,current_xpos,current_ypos,xinc,yinc, 0);
+                                 cps3_push_cmd(fsz,realtileno,actualpal,flipx,flipy,current_xpos,current_ypos,xinc,yinc, 0);
                               }
                            }
                            count++;
@@ -1942,77 +2198,329 @@ static void DrvDraw(void)
 			}
 		}
 	}
-	
+
+	cps3_flush_cmds(fsz);
+}
+
+static INT32 WideScreenFrameDelay = 0;
+
+// output stage, palette lookup of the screen bitmap into the frame.
+// widths are 384 or 496, both multiples of 4
+static INT32 cps3_out_col[496];		// source column of each output pixel when zoomed
+static UINT32 cps3_out_fsz;
+static INT32 cps3_out_width;
+
+template <typename T>
+static void cps3_output_row(T * dst, const UINT32 * src, const T * pal, INT32 width)
+{
+	for (INT32 x = 0; x < width; x += 4)
+   {
+		T c0 = pal[src[x + 0]], c1 = pal[src[x + 1]];
+		T c2 = pal[src[x + 2]], c3 = pal[src[x + 3]];
+		dst[x + 0] = c0;
+		dst[x + 1] = c1;
+		dst[x + 2] = c2;
+		dst[x + 3] = c3;
+	}
+}
+
+template <typename T>
+static void cps3_output_row_zoom(T * dst, const UINT32 * src, const T * pal, const INT32 * col, INT32 width)
+{
+	for (INT32 x = 0; x < width; x += 4)
+   {
+		T c0 = pal[src[col[x + 0]]], c1 = pal[src[col[x + 1]]];
+		T c2 = pal[src[col[x + 2]]], c3 = pal[src[col[x + 3]]];
+		dst[x + 0] = c0;
+		dst[x + 1] = c1;
+		dst[x + 2] = c2;
+		dst[x + 3] = c3;
+	}
+}
+
+// palette lookup and text layer for the bands that changed, T is the frame pixel
+template <typename T>
+static void DrvRenderOutput(cps3_frame_job * job)
+{
+	UINT32 fsz   = job->fsz;
+	UINT32 bands = job->bands;
+
 	{
-		UINT32 srcx, srcy = 0;
-		UINT32 * srcbitmap;
-		UINT16 * dstbitmap = (UINT16 * )pBurnDraw;
+		UINT32 srcy = 0;
+		T * dstbitmap = (T *)DrawDest;
+		const T * pal = (const T *)DrawPal;
 
-		for (INT32 rendery=0; rendery<224; rendery++)
+		if (fsz != 0x10000 && (fsz != cps3_out_fsz || cps3_gfx_width != cps3_out_width))
+		{
+			UINT32 srcx = 0;
+			for (INT32 renderx = 0; renderx < cps3_gfx_width; renderx++, srcx += fsz)
+				cps3_out_col[renderx] = srcx >> 16;
+			cps3_out_fsz   = fsz;
+			cps3_out_width = cps3_gfx_width;
+		}
+
+		for (INT32 rendery=0; rendery<224; rendery++, srcy += fsz, dstbitmap += cps3_gfx_width)
       {
-         srcbitmap = RamScreen + (srcy >> 16) * 1024;
-         srcx=0;
-         for (INT32 renderx=0; renderx<cps3_gfx_width; renderx++, dstbitmap ++) {
-            *dstbitmap = Cps3CurPal[ srcbitmap[srcx>>16] ];
-            srcx += fsz;
-         }
-         srcy += fsz;
+         if (~bands & (1 << (rendery >> 3)))
+            continue;
+
+         UINT32 * srcbitmap = RamScreen + (srcy >> 16) * 1024;
+         if (fsz == 0x10000)
+            cps3_output_row(dstbitmap, srcbitmap, pal, cps3_gfx_width);
+         else
+            cps3_output_row_zoom(dstbitmap, srcbitmap, pal, cps3_out_col, cps3_gfx_width);
       }
 	}
 	
 	if (nBurnLayer & 2)
 	{
 		// bank select? (sfiii2 intro)
-		INT32 count = (ss_bank_base & 0x01000000) ? 0x0000 : 0x0800;
+		INT32 count = job->ss_base;
 		for (INT32 y=0; y<32-4; y++)
       {
+			if (~bands & (1 << y))
+         {
+            count += 64;
+            continue;
+         }
 			for (INT32 x=0; x<64; x++, count++)
          {
-            UINT32 data  = RamSS[count]; // +0x800 = 2nd bank, used on sfiii2 intro..
+            UINT32 data  = SSDrawn[count]; // +0x800 = 2nd bank, used on sfiii2 intro..
             UINT32 tile  = (data >> 16) & 0x1ff;
             INT32 pal    = (data & 0x003f) >> 1;
             INT32 flipx  = data & 0x0080;
             INT32 flipy  = data & 0x0040;
-            pal         += ss_pal_base << 5;
+            pal         += job->ss_pal << 5;
 
             if (tile == 0)
                continue; // ok?
 
             tile        += 0x200;
-            cps3_drawgfxzoom_0(tile,pal,flipx,flipy,x*8,y*8);
+            cps3_drawgfxzoom_0<T>(tile,pal,flipx,flipy,x*8,y*8);
          }
 		}
 	}
 }
 
+// draws one frame from the *Drawn copies, on a background thread when pipelined
+static void DrvRender(INT32, void * param)
+{
+	cps3_frame_job * job = (cps3_frame_job *)param;
+
+	if (job->dirty & CPS3_DIRTY_GFX)
+		DrvDrawScreen(job->fsz);
+
+	if (job->bpp == 4)
+		DrvRenderOutput<UINT32>(job);
+	else
+		DrvRenderOutput<UINT16>(job);
+}
+
+// switches between drawing in place and the pipelined renderer
+static void cps3_pipeline_set(INT32 enable)
+{
+	BurnThreadWait();
+
+	if (enable && CRamDrawn == NULL)
+	{
+		CRamDrawn = (UINT32 *)BurnMalloc(0x0200000 * sizeof(UINT32));
+		if (CRamDrawn == NULL)
+		{
+			EnableRenderPipeline = 0;
+			enable = 0;
+		}
+	}
+
+	cps3_pipelined = enable;
+	DrawCRam       = enable ? CRamDrawn : RamCRam;
+	DrawPal        = enable ? PalDrawn : Cps3CurPal;
+	DrawDest       = enable ? FrameDrawn : pBurnDraw;
+	cps3_job.width = 0;
+	cps3_dirty     = CPS3_DIRTY_ALL;
+	memset(cps3_cram_pages, 1, sizeof(cps3_cram_pages));
+}
+
+static void DrvDraw(void)
+{
+	INT32 Width, Height;
+
+	// the frame in flight uses the copies and sizes set up below
+	BurnThreadWait();
+
+	if (EnableRenderPipeline != cps3_pipelined)
+		cps3_pipeline_set(EnableRenderPipeline);
+
+	if (cps3_pipelined)
+	{
+		// show the frame finished in the background
+		// pBurnDraw keeps its contents, a frame is only copied once
+		if (cps3_job.width == cps3_gfx_width)
+			memcpy(pBurnDraw, FrameDrawn, cps3_gfx_width * 224 * cps3_job.bpp);
+		cps3_job.width = 0;
+	}
+	else
+		DrawDest = pBurnDraw;
+
+	UINT32 fullscreenzoom          = RamVReg[ 6 * 4 + 3 ] & 0xff;
+	UINT32 fullscreenzoomwidecheck = RamVReg[6 * 4 + 1];
+	
+	BurnDrvGetVisibleSize(&Width, &Height);
+	if (((fullscreenzoomwidecheck & 0xffff0000) >> 16) == 0x0265)
+	{
+		if (Width != 496)
+		{
+			BurnDrvSetVisibleSize(496, 224);
+			BurnDrvSetAspect(16, 9);
+			Reinitialise();
+			WideScreenFrameDelay = GetCurrentFrame() + 1;
+		}
+	}
+	else
+	{
+		if (Width != 384)
+		{
+			BurnDrvSetVisibleSize(384, 224);
+			BurnDrvSetAspect(4, 3);
+			Reinitialise();
+			WideScreenFrameDelay = GetCurrentFrame() + 1;
+		}
+	}
+	
+	if (fullscreenzoom > 0x80)
+      fullscreenzoom = 0x80;
+	UINT32 fsz     = (fullscreenzoom << (16 - 6));
+	cps3_gfx_max_x = ((cps3_gfx_width * fsz)  >> 16) - 1;	// 384 ( 496 for SFIII2 Only)
+	cps3_gfx_max_y = ((cps3_gfx_height * fsz) >> 16) - 1;	// 224
+
+	if (fsz != cps3_drawn_fsz || (UINT32)cps3_gfx_width != cps3_drawn_width ||
+       (UINT32)nBurnLayer != cps3_drawn_layer || (UINT32)nSpriteEnable != cps3_drawn_sprite)
+	{
+		cps3_drawn_fsz    = fsz;
+		cps3_drawn_width  = cps3_gfx_width;
+		cps3_drawn_layer  = nBurnLayer;
+		cps3_drawn_sprite = nSpriteEnable;
+		cps3_dirty        = CPS3_DIRTY_ALL;
+	}
+
+	// sprite ram pages are rewritten every frame, only a real change counts
+	for (INT32 i = 0; i < 8; i++)
+	{
+		if (~cps3_spr_written & (1 << i))
+			continue;
+		if (memcmp(RamSpr + i * 0x4000, SprDrawn + i * 0x4000, 0x10000))
+		{
+			memcpy(SprDrawn + i * 0x4000, RamSpr + i * 0x4000, 0x10000);
+			cps3_dirty |= CPS3_DIRTY_GFX;
+		}
+	}
+	if (cps3_cram_written)
+		cps3_dirty |= CPS3_DIRTY_GFX;
+
+	// text layer, one band per 8 line row of tiles
+	UINT32 bands = 0;
+	UINT32 ss_base = (ss_bank_base & 0x01000000) ? 0x0000 : 0x0800;
+
+	if (ss_base != cps3_drawn_ss_bank || ss_pal_base != cps3_drawn_ss_pal)
+	{
+		cps3_drawn_ss_bank = ss_base;
+		cps3_drawn_ss_pal  = ss_pal_base;
+		bands              = 0x0fffffff;
+	}
+	if (cps3_ss_written)
+	{
+		// tiles 0x200 - 0x3ff live in the upper half
+		if (memcmp(RamSS + 0x2000, SSDrawn + 0x2000, 0x8000))
+			bands = 0x0fffffff;
+		else
+			for (INT32 y = 0; y < 28; y++)
+				if (memcmp(RamSS + ss_base + y * 64, SSDrawn + ss_base + y * 64, 64 * sizeof(UINT32)))
+					bands |= 1 << y;
+		memcpy(SSDrawn, RamSS, 0x10000);
+	}
+	if (cps3_dirty)
+		bands = 0x0fffffff;
+
+	cps3_spr_written  = 0;
+	cps3_ss_written   = 0;
+	cps3_cram_written = 0;
+	cps3_track_arm();
+
+	if (bands == 0)
+		return;
+
+	memcpy(VRegDrawn, RamVReg, 0x40 * sizeof(UINT32));
+
+	cps3_job.fsz     = fsz;
+	cps3_job.bands   = bands;
+	cps3_job.dirty   = cps3_dirty;
+	cps3_job.ss_base = ss_base;
+	cps3_job.ss_pal  = ss_pal_base;
+	cps3_job.width   = cps3_gfx_width;
+	cps3_job.bpp     = cps3_bpp;
+	cps3_dirty       = 0;
+
+	if (cps3_pipelined)
+	{
+		for (INT32 i = 0; i < 0x80; i++)
+		{
+			if (cps3_cram_pages[i])
+			{
+				memcpy(CRamDrawn + i * 0x4000, RamCRam + i * 0x4000, 0x10000);
+				cps3_cram_pages[i] = 0;
+			}
+		}
+		if (cps3_job.dirty & CPS3_DIRTY_PAL)
+			memcpy(PalDrawn, Cps3CurPal, 0x20000 * cps3_bpp);
+
+		BurnThreadAsync(DrvRender, &cps3_job);
+	}
+	else
+		DrvRender(0, &cps3_job);
+}
+
 static INT32 cps_int10_cnt = 0;
 
+#define CPS3_SLICE_CYCLES	(6250000 * 4 / 60 / 4)
+
+// runs nCycles, stopping on the way for a background char dma's irq
+static void cps3_run_slice(INT32 nCycles)
+{
+	INT32 end = Sh2TotalCycles() + nCycles;
+
+	while (cps3_chardma_irq && cps3_chardma_irq_cycle - Sh2TotalCycles() < end - Sh2TotalCycles())
+   {
+		INT32 due = cps3_chardma_irq_cycle - Sh2TotalCycles();
+		if (due > 0)
+			Sh2Run(due);
+		cps3_chardma_raise();
+	}
+
+	if (end - Sh2TotalCycles() > 0)
+		Sh2Run(end - Sh2TotalCycles());
+}
+
 INT32 cps3Frame(void)
 {
+	// with SH2_THREAD_CONTEXTS the current SH-2 is kept per thread, and
+	// the frontend need not call in from the thread that loaded the game
+	Sh2Open(0);
+
 	if (cps3_reset)
 		Cps3Reset();
 		
-	if (cps3_palette_change)
-	{
-		for(INT32 i=0;i<0x0020000;i++)
-		{
-#ifdef MSB_FIRST
-			INT32 data = RamPal[i];
-#else
-			INT32 data = RamPal[i ^ 1];
-#endif
-			INT32 r = (data & 0x001F) << 3;	// Red
-			INT32 g = (data & 0x03E0) >> 2;	// Green
-			INT32 b = (data & 0x7C00) >> 7;	// Blue
-			r |= r >> 5;
-			g |= g >> 5;
-			b |= b >> 5;
-			Cps3CurPal[i] = BurnHighCol(r, g, b, 0);	
-		}
-		cps3_palette_change = 0;
-	}
+	if (cps3_palette_change || cps3_pal_check)
+		cps3_palette_update();
+
+	// between frames no char dma is running
+	if (CharDmaCacheMB != cps3_dma_cache_mb)
+		cps3_dma_cache_set(CharDmaCacheMB);
+
+	// a whole frame without entering the ROM test
+	if (cps3_rom_test > 0 && --cps3_rom_test == 0)
+		cps3_rom_map();
 	
 	if (WideScreenFrameDelay == GetCurrentFrame()) {
+		BurnThreadWait();
 		BurnDrvGetVisibleSize(&cps3_gfx_width, &cps3_gfx_height);
 		WideScreenFrameDelay = 0;
 	}
@@ -2031,9 +2539,12 @@ INT32 cps3Frame(void)
 	Cps3ClearOpposites(&Cps3Input[0]);
 	Cps3ClearOpposites(&Cps3Input[1]);
 
+	Sh2NewFrame();
+	cps3SndNewFrame(CPS3_SLICE_CYCLES * 4);
+
 	for (INT32 i=0; i<4; i++)
 	{
-		Sh2Run(6250000 * 4 / 60 / 4);
+		cps3_run_slice(CPS3_SLICE_CYCLES);
 		
 		if (cps_int10_cnt >= 2)
       {
@@ -2043,6 +2554,10 @@ INT32 cps3Frame(void)
       else
          cps_int10_cnt++;
 	}
+	// a transfer still running is done by vblank
+	if (cps3_chardma_irq)
+		cps3_chardma_raise();
+
 	Sh2SetIRQLine(12, SH2_IRQSTATUS_AUTO);
 
 	cps3SndUpdate();
@@ -2056,6 +2571,9 @@ INT32 cps3Scan(INT32 nAction, INT32 *pnMin)
 {
 	struct BurnArea ba;
 
+	Sh2Open(0);
+	cps3_chardma_finish();
+
 	if (pnMin)
       *pnMin =  0x029672;
 	
@@ -2154,11 +2672,17 @@ INT32 cps3Scan(INT32 nAction, INT32 *pnMin)
 				
 		if (nAction & ACB_WRITE)
       {
-			// rebuild current palette
-			cps3_palette_change = 1;
+			// convert the palette blocks the state changed
+			cps3_pal_check = 1;
 			
 			// remap RamCRam
 			Sh2MapMemory(((UINT8 *)RamCRam) + (cram_bank << 20), 0x04100000, 0x041fffff, SH2_RAM);
+			cps3_track_reset();
+
+			// the state may be saved inside the ROM test, give it a frame to show up
+			if (cps3_rom_test >= 0)
+				cps3_rom_test = 2;
+			cps3_rom_map();
 		}
 	}
 	
@@ -1,11 +1,30 @@
 #include "cps3.h"
+#include "sh2_intf.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CPS3_SND_SSE2	1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CPS3_SND_NEON	1
+#endif
+
+#ifndef M_PI
+#define M_PI	3.14159265358979323846
+#endif
 
 #define CPS3_VOICES		16
 
-#define CPS3_SND_INT_RATE		(nBurnFPS / 100)
-#define CPS3_SND_RATE			(42954500 / 3 / 384)
-#define CPS3_SND_BUFFER_SIZE	(CPS3_SND_RATE / CPS3_SND_INT_RATE)
-#define CPS3_SND_LINEAR_SHIFT	12
+// the chip runs at 42954500 / 3 / 384 = 37286.89 Hz and is resampled to nBurnSoundRate
+#define CPS3_SND_CLOCK			42954500
+#define CPS3_SND_DIVIDER		(3 * 384)
+
+#define CPS3_RES_BUF			4096	// native samples buffered per channel
+#define CPS3_RES_HIST			8		// native samples kept behind the read position
+#define CPS3_SINC_TAPS			16
+#define CPS3_SINC_PHASES		256
 
 typedef struct
 {
@@ -20,15 +39,28 @@ typedef struct
 	UINT16 key;
 
 	UINT8 * rombase;
-	UINT32 delta;
 	
 	double gain[2];
 	INT32 output_dir[2];
 
+	// native rate output waiting to be resampled
+	INT16 res_l[CPS3_RES_BUF];
+	INT16 res_r[CPS3_RES_BUF];
+	INT32 res_have;
+	UINT32 res_pos;			// 16.16, read position in res_l/res_r
+	UINT32 res_sinc_ratio;	// step the sinc table was built for
+
+	// this frame's rendering, paced by the SH-2 so register writes land on their sample
+	INT32 frame_cycles;		// 0 while nothing is being streamed
+	INT32 frame_start;
+	INT32 frame_need;
+
 } cps3snd_chip;
 
 static cps3snd_chip * chip;
 
+static void cps3SndSync(void);
+
 UINT8 __fastcall cps3SndReadByte(UINT32 addr)
 {
 	addr &= 0x000003ff;
@@ -41,7 +73,11 @@ UINT16 __fastcall cps3SndReadWord(UINT32 addr)
 	if (addr < 0x200)
 		return chip->voice[addr >> 5].regs[(addr>>1) & 0xf];
 	if (addr == 0x200)
+   {
+		// one shot voices key themselves off as they play
+		cps3SndSync();
 		return chip->key;
+	}
 	return 0;
 }
 
@@ -61,10 +97,19 @@ void __fastcall cps3SndWriteWord(UINT32 addr, UINT16 data)
 	addr &= 0x000003ff;
 	
 	if (addr < 0x200)
-		chip->voice[addr >> 5].regs[(addr>>1) & 0xf] = data;
+   {
+		UINT16 * reg = &chip->voice[addr >> 5].regs[(addr>>1) & 0xf];
+		if (*reg != data)
+      {
+			cps3SndSync();
+			*reg = data;
+		}
+	}
 	else
 	if (addr == 0x200)
 	{
+		cps3SndSync();
+
 		UINT16 key = data;
 		for (INT32 i = 0; i < CPS3_VOICES; i++)
       {
@@ -81,6 +126,14 @@ void __fastcall cps3SndWriteWord(UINT32 addr, UINT16 data)
 
 void __fastcall cps3SndWriteLong(UINT32 addr, UINT32 data) { }
 
+static void cps3SndResetResampler(void)
+{
+	memset(chip->res_l, 0, sizeof(chip->res_l));
+	memset(chip->res_r, 0, sizeof(chip->res_r));
+	chip->res_have = CPS3_RES_HIST;
+	chip->res_pos  = CPS3_RES_HIST << 16;
+}
+
 INT32 cps3SndInit(UINT8 * sndrom)
 {
 	chip = (cps3snd_chip *)BurnMalloc( sizeof(cps3snd_chip) );
@@ -94,13 +147,12 @@ INT32 cps3SndInit(UINT8 * sndrom)
 		 * Sound interupt 80Hz 
 		 */
 		
-		if (nBurnSoundRate)
-			chip->delta = (CPS3_SND_BUFFER_SIZE << CPS3_SND_LINEAR_SHIFT) / nBurnSoundLen;
-		
 		chip->gain[BURN_SND_CPS3SND_ROUTE_1] = 1.00;
 		chip->gain[BURN_SND_CPS3SND_ROUTE_2] = 1.00;
 		chip->output_dir[BURN_SND_CPS3SND_ROUTE_1] = BURN_SND_ROUTE_LEFT;
 		chip->output_dir[BURN_SND_CPS3SND_ROUTE_2] = BURN_SND_ROUTE_RIGHT;
+
+		cps3SndResetResampler();
 		
 		return 0;
 	}
@@ -115,81 +167,355 @@ void cps3SndSetRoute(INT32 nIndex, double nVolume, INT32 nRouteDir)
 
 void cps3SndExit(void) { BurnFree(chip); }
 
-void cps3SndUpdate(void)
+// voices are mixed into 32 bit accumulators a chunk at a time and clipped once
+#define CPS3_MIX_CHUNK	256
+
+static INT32 mix_l[CPS3_MIX_CHUNK];
+static INT32 mix_r[CPS3_MIX_CHUNK];
+static INT32 coef_l[CPS3_VOICES];
+static INT32 coef_r[CPS3_VOICES];
+
+// adds nLen native samples of one voice, keys it off when a one shot sample ends
+static void cps3SndMixVoice(cps3_voice * vptr, INT32 nVoice, INT32 nLen)
 {
-	if (!pBurnSoundOut)
-		return;	
-	
-	memset(pBurnSoundOut, 0, nBurnSoundLen * 2 * sizeof(INT16));
-	INT8 * base = (INT8 *)chip->rombase;
-	cps3_voice *vptr = &chip->voice[0];
+	INT8 * base  = (INT8 *)chip->rombase;
+	UINT32 start = ((vptr->regs[ 3] << 16) | vptr->regs[ 2]) - 0x400000;
+	UINT32 end   = ((vptr->regs[11] << 16) | vptr->regs[10]) - 0x400000;
+	UINT32 loop  = ((vptr->regs[ 9] << 16) | vptr->regs[ 7]) - 0x400000;
+	UINT32 step  = vptr->regs[ 6];	// 4.12
+	INT32 cl     = coef_l[nVoice];
+	INT32 cr     = coef_r[nVoice];
+
+	UINT32 pos   = vptr->pos + (vptr->frac >> 12);
+	UINT32 frac  = vptr->frac & 0xfff;
+
+	for (INT32 j = 0; j < nLen; )
+   {
+		if (start + pos >= end)
+      {
+			if (vptr->regs[5])
+				pos = loop - start;
+			else
+         {
+				chip->key &= ~(1 << nVoice);
+				vptr->pos  = pos;
+				vptr->frac = frac;
+				return;
+			}
+		}
 
-	for(INT32 i=0; i<CPS3_VOICES; i++, vptr++)
+		// samples left before the read position reaches the end address
+		INT32 n = nLen - j;
+		if (start + pos < end && step)
+      {
+			UINT64 left = ((UINT64)(end - start - pos) << 12) - frac;
+			if (left < (UINT64)n * step)
+				n = (INT32)((left + step - 1) / step);
+		}
+		else if (start + pos >= end)
+			n = 1;	// loop point past the end, take it one sample at a time
+
+		// 8bit sample store with 16bit bigend ???
+		UINT32 addr = start + pos;
+		INT32 * dl  = mix_l + j;
+		INT32 * dr  = mix_r + j;
+		UINT32 f    = frac;
+		for (INT32 k = 0; k < n; k++, f += step)
+      {
+			INT32 sample = base[(addr + (f >> 12)) ^ 1];
+			dl[k] += sample * cl;
+			dr[k] += sample * cr;
+		}
+
+		pos  += f >> 12;
+		frac  = f & 0xfff;
+		j    += n;
+	}
+
+	vptr->pos  = pos;
+	vptr->frac = frac;
+}
+
+// appends nLen native rate samples to the resampler input
+static void cps3SndRender(INT32 nLen)
+{
+	INT16 * dl = chip->res_l + chip->res_have;
+	INT16 * dr = chip->res_r + chip->res_have;
+	chip->res_have += nLen;
+
+	// routing and gain folded into one coefficient per route, 8 fractional bits
+	INT32 gain_l[2], gain_r[2];
+	for (INT32 r = 0; r < 2; r++)
    {
-      if (chip->key & (1 << i))
+		INT32 gain = (INT32)(chip->gain[r] * 256.0 + 0.5);
+		gain_l[r]  = (chip->output_dir[r] & BURN_SND_ROUTE_LEFT)  ? gain : 0;
+		gain_r[r]  = (chip->output_dir[r] & BURN_SND_ROUTE_RIGHT) ? gain : 0;
+	}
+
+	for (INT32 i = 0; i < CPS3_VOICES; i++)
+   {
+		INT32 vol_1 = (INT16)chip->voice[i].regs[15];
+		INT32 vol_2 = (INT16)chip->voice[i].regs[14];
+		coef_l[i]   = (vol_1 * gain_l[0] + vol_2 * gain_l[1]) >> 8;
+		coef_r[i]   = (vol_1 * gain_r[0] + vol_2 * gain_r[1]) >> 8;
+	}
+
+	while (nLen > 0)
+   {
+		INT32 n = nLen > CPS3_MIX_CHUNK ? CPS3_MIX_CHUNK : nLen;
+
+		memset(mix_l, 0, n * sizeof(INT32));
+		memset(mix_r, 0, n * sizeof(INT32));
+
+		for (INT32 i = 0; i < CPS3_VOICES; i++)
+			if (chip->key & (1 << i))
+				cps3SndMixVoice(&chip->voice[i], i, n);
+
+		for (INT32 j = 0; j < n; j++)
       {
-         UINT32 start   = ((vptr->regs[ 3] << 16) | vptr->regs[ 2]) - 0x400000;
-         UINT32 end     = ((vptr->regs[11] << 16) | vptr->regs[10]) - 0x400000;
-         UINT32 loop    = ((vptr->regs[ 9] << 16) | vptr->regs[ 7]) - 0x400000;
-         UINT32 step    = ( vptr->regs[ 6] * chip->delta ) >> CPS3_SND_LINEAR_SHIFT;
+			INT32 l = mix_l[j] >> 8;
+			INT32 r = mix_r[j] >> 8;
+			dl[j]   = BURN_SND_CLIP(l);
+			dr[j]   = BURN_SND_CLIP(r);
+		}
 
-         INT32 vol_l    = (INT16)vptr->regs[15];
-         INT32 vol_r    = (INT16)vptr->regs[14];
+		dl   += n;
+		dr   += n;
+		nLen -= n;
+	}
+}
 
-         UINT32 pos     = vptr->pos;
-         UINT32 frac    = vptr->frac;
+// nInterpolation picks the resampler: 0 nearest, 1 linear, 2-3 4 point cubic,
+// 4 and up a 16 tap windowed sinc. Filters are 1.14 fixed point.
+static INT16 cubic_table[CPS3_SINC_PHASES][4];
+static INT16 sinc_table[CPS3_SINC_PHASES][CPS3_SINC_TAPS];
 
-         /* Go through the buffer and add voice contributions */
-         INT16 * buffer = (INT16 *)pBurnSoundOut;
+static void cps3SndBuildCubic(void)
+{
+	if (cubic_table[0][1])
+		return;
 
-         for (INT32 j=0; j<nBurnSoundLen; j++)
-         {
-            INT32 sample;
+	for (INT32 p = 0; p < CPS3_SINC_PHASES; p++)
+   {
+		// Catmull-Rom through the samples at -1, 0, 1 and 2
+		double x = (double)p / CPS3_SINC_PHASES;
+		cubic_table[p][0] = (INT16)floor(16384.0 * (-0.5 * x + x * x - 0.5 * x * x * x) + 0.5);
+		cubic_table[p][1] = (INT16)floor(16384.0 * (1.0 - 2.5 * x * x + 1.5 * x * x * x) + 0.5);
+		cubic_table[p][2] = (INT16)floor(16384.0 * (0.5 * x + 2.0 * x * x - 1.5 * x * x * x) + 0.5);
+		cubic_table[p][3] = (INT16)floor(16384.0 * (-0.5 * x * x + 0.5 * x * x * x) + 0.5);
+	}
+}
 
-            pos += (frac >> 12);
-            frac &= 0xfff;
+static void cps3SndBuildSinc(UINT32 ratio)
+{
+	// cut off below the lower of the two nyquist rates
+	double fc = 0.90 * (ratio > 0x10000 ? 65536.0 / ratio : 1.0);
 
-            if (start + pos >= end)
-            {
-               if (vptr->regs[5])
-                  pos = loop - start;
-               else
-               {
-                  chip->key &= ~(1 << i);
-                  break;
-               }
-            }
+	for (INT32 p = 0; p < CPS3_SINC_PHASES; p++)
+   {
+		double h[CPS3_SINC_TAPS], sum = 0.0;
+		double x = (double)p / CPS3_SINC_PHASES;
 
-            // 8bit sample store with 16bit bigend ???
-            sample = base[(start + pos) ^ 1];
-            frac += step;
+		for (INT32 t = 0; t < CPS3_SINC_TAPS; t++)
+      {
+			double d = (t - (CPS3_SINC_TAPS / 2 - 1)) - x;	// taps -7 .. 8
+			double a = M_PI * fc * d;
+			double w = 0.42 + 0.5 * cos(M_PI * d / (CPS3_SINC_TAPS / 2)) + 0.08 * cos(2.0 * M_PI * d / (CPS3_SINC_TAPS / 2));
+			h[t]     = (d == 0.0 ? 1.0 : sin(a) / a) * w;
+			sum     += h[t];
+		}
 
-            INT32 nLeftSample = 0, nRightSample = 0;
+		// unity gain at dc for every phase
+		INT32 total = 0;
+		for (INT32 t = 0; t < CPS3_SINC_TAPS; t++)
+      {
+			sinc_table[p][t] = (INT16)floor(16384.0 * h[t] / sum + 0.5);
+			total           += sinc_table[p][t];
+		}
+		sinc_table[p][CPS3_SINC_TAPS / 2 - 1 + (p >= CPS3_SINC_PHASES / 2)] += 16384 - total;
+	}
 
-            if ((chip->output_dir[BURN_SND_CPS3SND_ROUTE_1] & BURN_SND_ROUTE_LEFT) == BURN_SND_ROUTE_LEFT)
-               nLeftSample += (INT32)(((sample * vol_l) >> 8) * chip->gain[BURN_SND_CPS3SND_ROUTE_1]);
-            if ((chip->output_dir[BURN_SND_CPS3SND_ROUTE_1] & BURN_SND_ROUTE_RIGHT) == BURN_SND_ROUTE_RIGHT)
-               nRightSample += (INT32)(((sample * vol_l) >> 8) * chip->gain[BURN_SND_CPS3SND_ROUTE_1]);
+	chip->res_sinc_ratio = ratio;
+}
 
-            if ((chip->output_dir[BURN_SND_CPS3SND_ROUTE_2] & BURN_SND_ROUTE_LEFT) == BURN_SND_ROUTE_LEFT)
-               nLeftSample += (INT32)(((sample * vol_r) >> 8) * chip->gain[BURN_SND_CPS3SND_ROUTE_2]);
-            if ((chip->output_dir[BURN_SND_CPS3SND_ROUTE_2] & BURN_SND_ROUTE_RIGHT) == BURN_SND_ROUTE_RIGHT)
-               nRightSample += (INT32)(((sample * vol_r) >> 8) * chip->gain[BURN_SND_CPS3SND_ROUTE_2]);
+static inline void cps3SndSinc(const INT16 * l, const INT16 * r, const INT16 * c, INT32 * out_l, INT32 * out_r)
+{
+#if defined(CPS3_SND_SSE2)
+	__m128i c0 = _mm_loadu_si128((const __m128i *)c);
+	__m128i c1 = _mm_loadu_si128((const __m128i *)(c + 8));
+	__m128i sl = _mm_add_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i *)l), c0), _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(l + 8)), c1));
+	__m128i sr = _mm_add_epi32(_mm_madd_epi16(_mm_loadu_si128((const __m128i *)r), c0), _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(r + 8)), c1));
+	// horizontal sums, left in lane 0 and right in lane 2
+	__m128i lo = _mm_unpacklo_epi64(sl, sr);
+	__m128i hi = _mm_unpackhi_epi64(sl, sr);
+	__m128i s  = _mm_add_epi32(lo, hi);
+	s          = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+	*out_l     = _mm_cvtsi128_si32(s);
+	*out_r     = _mm_cvtsi128_si32(_mm_shuffle_epi32(s, _MM_SHUFFLE(2, 2, 2, 2)));
+#elif defined(CPS3_SND_NEON)
+	int16x8_t c0 = vld1q_s16(c), c1 = vld1q_s16(c + 8);
+	int16x8_t l0 = vld1q_s16(l), l1 = vld1q_s16(l + 8);
+	int16x8_t r0 = vld1q_s16(r), r1 = vld1q_s16(r + 8);
+	int32x4_t sl = vmull_s16(vget_low_s16(l0), vget_low_s16(c0));
+	int32x4_t sr = vmull_s16(vget_low_s16(r0), vget_low_s16(c0));
+	sl = vmlal_s16(sl, vget_high_s16(l0), vget_high_s16(c0));
+	sr = vmlal_s16(sr, vget_high_s16(r0), vget_high_s16(c0));
+	sl = vmlal_s16(sl, vget_low_s16(l1), vget_low_s16(c1));
+	sr = vmlal_s16(sr, vget_low_s16(r1), vget_low_s16(c1));
+	sl = vmlal_s16(sl, vget_high_s16(l1), vget_high_s16(c1));
+	sr = vmlal_s16(sr, vget_high_s16(r1), vget_high_s16(c1));
+	int32x2_t s = vpadd_s32(vadd_s32(vget_low_s32(sl), vget_high_s32(sl)), vadd_s32(vget_low_s32(sr), vget_high_s32(sr)));
+	*out_l = vget_lane_s32(s, 0);
+	*out_r = vget_lane_s32(s, 1);
+#else
+	INT32 sl = 0, sr = 0;
+	for (INT32 t = 0; t < CPS3_SINC_TAPS; t++)
+   {
+		sl += l[t] * c[t];
+		sr += r[t] * c[t];
+	}
+	*out_l = sl;
+	*out_r = sr;
+#endif
+}
 
-            nLeftSample  = BURN_SND_CLIP(nLeftSample + buffer[1]);
-            nRightSample = BURN_SND_CLIP(nRightSample + buffer[0]);
+// resamples nLen stereo samples into buffer, the input must reach CPS3_SINC_TAPS / 2 past the last one
+static void cps3SndResample(INT16 * buffer, INT32 nLen, UINT32 ratio)
+{
+	const INT16 * res_l = chip->res_l;
+	const INT16 * res_r = chip->res_r;
+	UINT32 pos = chip->res_pos;
 
-            buffer[0]    = nRightSample; // swapped. correct??
-            buffer[1]    = nLeftSample;
+	for (INT32 j = 0; j < nLen; j++, pos += ratio, buffer += 2)
+   {
+		INT32 i = pos >> 16;
+		INT32 f = pos & 0xffff;
+		INT32 l, r;
 
-            buffer      += 2;
-         }
+		if (nInterpolation <= 0)
+      {
+			i += f >> 15;
+			l  = res_l[i];
+			r  = res_r[i];
+		}
+		else if (nInterpolation == 1)
+      {
+			l  = res_l[i] + (((res_l[i + 1] - res_l[i]) * (f >> 2)) >> 14);
+			r  = res_r[i] + (((res_r[i + 1] - res_r[i]) * (f >> 2)) >> 14);
+		}
+		else if (nInterpolation <= 3)
+      {
+			const INT16 * c = cubic_table[f >> 8];
+			l  = (res_l[i - 1] * c[0] + res_l[i] * c[1] + res_l[i + 1] * c[2] + res_l[i + 2] * c[3] + 0x2000) >> 14;
+			r  = (res_r[i - 1] * c[0] + res_r[i] * c[1] + res_r[i + 1] * c[2] + res_r[i + 2] * c[3] + 0x2000) >> 14;
+		}
+		else
+      {
+			i -= CPS3_SINC_TAPS / 2 - 1;
+			cps3SndSinc(res_l + i, res_r + i, sinc_table[f >> 8], &l, &r);
+			l  = (l + 0x2000) >> 14;
+			r  = (r + 0x2000) >> 14;
+		}
 
+		buffer[0] = BURN_SND_CLIP(r); // swapped. correct??
+		buffer[1] = BURN_SND_CLIP(l);
+	}
+
+	chip->res_pos = pos;
+}
 
-         vptr->pos = pos;
-         vptr->frac = frac;
-      }
-   }
+// native samples per output sample, 16.16. It depends on the rate only, the
+// frontend may hand out frames a sample longer or shorter to carry the fraction
+static UINT32 cps3SndRatio(void)
+{
+	return (UINT32)(((UINT64)CPS3_SND_CLOCK << 16) / ((UINT64)CPS3_SND_DIVIDER * nBurnSoundRate));
+}
+
+// called before the SH-2 runs a frame of nCycles
+void cps3SndNewFrame(INT32 nCycles)
+{
+	chip->frame_cycles = 0;
+
+	if (!pBurnSoundOut || nBurnSoundLen <= 0 || nBurnSoundRate <= 0 || nCycles <= 0)
+		return;
+
+	// everything cps3SndUpdate will read at the end of the frame
+	INT32 need = (INT32)((chip->res_pos + (UINT64)(nBurnSoundLen - 1) * cps3SndRatio()) >> 16) + CPS3_SINC_TAPS / 2 + 1;
+	if (need > CPS3_RES_BUF)
+		need = CPS3_RES_BUF;
+
+	chip->frame_start  = chip->res_have;
+	chip->frame_need   = need;
+	chip->frame_cycles = nCycles;
+}
+
+// renders up to the current SH-2 time, before a register write changes what plays
+static void cps3SndSync(void)
+{
+	if (chip->frame_cycles <= 0)
+		return;
+
+	INT32 cycles = Sh2TotalCycles();
+	if (cycles <= 0)
+		return;
+	if (cycles > chip->frame_cycles)
+		cycles = chip->frame_cycles;
+
+	INT32 target = chip->frame_start + (INT32)((INT64)(chip->frame_need - chip->frame_start) * cycles / chip->frame_cycles);
+	if (target > chip->res_have)
+		cps3SndRender(target - chip->res_have);
+}
+
+void cps3SndUpdate(void)
+{
+	chip->frame_cycles = 0;
+
+	if (!pBurnSoundOut || nBurnSoundLen <= 0 || nBurnSoundRate <= 0)
+		return;	
+
+	UINT32 ratio = cps3SndRatio();
+
+	if (nInterpolation >= 4)
+   {
+		if (ratio != chip->res_sinc_ratio)
+			cps3SndBuildSinc(ratio);
+	}
+	else if (nInterpolation >= 2)
+		cps3SndBuildCubic();
+
+	// longest chunk whose input fits in the buffer
+	INT32 nMax = (INT32)(((UINT64)(CPS3_RES_BUF - CPS3_RES_HIST - CPS3_SINC_TAPS - 2) << 16) / ratio);
+	if (nMax > CPS3_MIX_CHUNK)
+		nMax = CPS3_MIX_CHUNK;
+
+	INT16 * buffer = pBurnSoundOut;
+
+	for (INT32 done = 0; done < nBurnSoundLen; )
+   {
+		INT32 nLen = nBurnSoundLen - done;
+		if (nLen > nMax)
+			nLen = nMax;
+
+		// render what this chunk reads, up to the last sinc tap
+		INT32 need = (INT32)((chip->res_pos + (UINT64)(nLen - 1) * ratio) >> 16) + CPS3_SINC_TAPS / 2 + 1;
+		if (need > chip->res_have)
+			cps3SndRender(need - chip->res_have);
+
+		cps3SndResample(buffer, nLen, ratio);
+
+		// keep the history the filters look back at
+		INT32 drop = (INT32)(chip->res_pos >> 16) - CPS3_RES_HIST;
+		if (drop > 0)
+      {
+			chip->res_have -= drop;
+			memmove(chip->res_l, chip->res_l + drop, chip->res_have * sizeof(INT16));
+			memmove(chip->res_r, chip->res_r + drop, chip->res_have * sizeof(INT16));
+			chip->res_pos  -= drop << 16;
+		}
+
+		buffer += nLen * 2;
+		done   += nLen;
+	}
 }
 
 INT32 cps3SndScan(INT32 nAction)
@@ -199,7 +525,9 @@ INT32 cps3SndScan(INT32 nAction)
 		SCAN_VAR( chip->voice );
 		SCAN_VAR( chip->key );
 		
+		// the buffered native samples are not saved, start clean
+		if (nAction & ACB_WRITE)
+			cps3SndResetResampler();
 	}
 	return 0;
 }
-
@@ -0,0 +1,262 @@
+// Checks the CPS3 character dma decoders in cps3_chardma.inc against the
+// byte at a time decoders they replaced. Random transfers in both modes go
+// to random destinations, near the end of char ram and past it, and char
+// ram has to match after every one. "make -f makefile.libretro test" runs
+// it with BE_GFX 1, as the driver is built, and with BE_GFX 0.
+
+#include "burnint.h"
+#include <stdio.h>
+
+#ifndef BE_GFX
+#define BE_GFX	1
+#endif
+
+#define ROM_SIZE	0x1000000
+#define CRAM_SIZE	0x800000
+
+static UINT8 * RomUser;
+static UINT32 * RamCRam;
+static UINT32 chardma_table_address;
+
+#include "../cps3_chardma.inc"
+
+// -- the code cps3_chardma.inc replaced, as it was --------------------------
+
+namespace ref {
+
+static UINT32 * RamCRam;
+
+static INT32 last_normal_byte = 0;
+
+static UINT32 process_byte( UINT8 real_byte, UINT32 destination, INT32 max_length )
+{
+   UINT8 * dest = (UINT8 *) RamCRam;
+   destination &= 0x7fffff;
+
+   if (real_byte&0x40)
+   {
+      INT32 tranfercount    = 0;
+      INT32 cps3_rle_length = (real_byte&0x3f)+1;
+      while (cps3_rle_length)
+      {
+#if BE_GFX
+         dest[((destination+tranfercount)&0x7fffff)]   = (last_normal_byte&0x3f);
+#else
+         dest[((destination+tranfercount)&0x7fffff)^3] = (last_normal_byte&0x3f);
+#endif
+         tranfercount++;
+         cps3_rle_length--;
+         max_length--;
+         if ((destination+tranfercount) > 0x7fffff)
+            return max_length;
+      }
+      return tranfercount;
+   }
+#if BE_GFX
+   dest[(destination&0x7fffff)]   = real_byte;
+#else
+   dest[(destination&0x7fffff)^3] = real_byte;
+#endif
+   last_normal_byte = real_byte;
+   return 1;
+}
+
+static void cps3_do_char_dma(
+      UINT32 real_source, UINT32 real_destination, UINT32 real_length )
+{
+	UINT8 * sourcedata     = RomUser;
+	INT32 length_remaining = real_length;
+	last_normal_byte       = 0;
+	while (length_remaining)
+	{
+		UINT8 current_byte  = sourcedata[ real_source ^ 0 ];
+		real_source++;
+
+		if (current_byte & 0x80)
+      {
+         UINT8 real_byte;
+         UINT32 length_processed;
+         current_byte &= 0x7f;
+
+         real_byte         = sourcedata[ (chardma_table_address+current_byte*2+0) ^ 0 ];
+         length_processed  = process_byte( real_byte, real_destination, length_remaining );
+         length_remaining -= length_processed; // subtract the number of bytes the operation has taken
+         real_destination += length_processed; // add it onto the destination
+         if (real_destination>0x7fffff)
+            return;
+         if (length_remaining<=0)
+            return; // if we've expired, exit
+
+         real_byte = sourcedata[ (chardma_table_address+current_byte*2+1) ^ 0 ];
+         length_processed = process_byte( real_byte, real_destination, length_remaining );
+         length_remaining -= length_processed; // subtract the number of bytes the operation has taken
+         real_destination += length_processed; // add it onto the destination
+         if (real_destination>0x7fffff)
+            return;
+         if (length_remaining<=0)
+            return;  // if we've expired, exit
+      }
+		else
+		{
+			UINT32 length_processed;
+			length_processed = process_byte( current_byte, real_destination, length_remaining );
+			length_remaining -= length_processed; // subtract the number of bytes the operation has taken
+			real_destination += length_processed; // add it onto the destination
+			if (real_destination>0x7fffff)
+				return;
+			if (length_remaining<=0)
+				return;  // if we've expired, exit
+		}
+	}
+}
+
+static UINT16 lastb;
+static UINT16 lastb2;
+
+static UINT32 ProcessByte8(UINT8 b, UINT32 dst_offset)
+{
+	UINT8 * destRAM = (UINT8 *) RamCRam;
+ 	INT32 l=0;
+
+ 	if(lastb==lastb2) /* RLE */
+	{
+ 		INT32 rle=(b+1)&0xff;
+
+ 		for(INT32 i=0;i<rle;++i)
+		{
+#if BE_GFX
+			destRAM[(dst_offset&0x7fffff)] = lastb;
+#else
+			destRAM[(dst_offset&0x7fffff)^3] = lastb;
+#endif
+			dst_offset++;
+ 			++l;
+ 		}
+ 		lastb2=0xffff;
+ 	}
+	else
+	{
+ 		lastb2=lastb;
+ 		lastb=b;
+#if BE_GFX
+		destRAM[(dst_offset&0x7fffff)] = b;
+#else
+		destRAM[(dst_offset&0x7fffff)^3] = b;
+#endif
+ 	}
+	return 1;
+}
+
+static void cps3_do_alt_char_dma(
+      UINT32 src, UINT32 real_dest, UINT32 real_length )
+{
+   UINT8 * px   = RomUser;
+   UINT32 start = real_dest;
+   UINT32 ds    = real_dest;
+
+   lastb=0xfffe;
+   lastb2=0xffff;
+
+   for(;;)
+   {
+      UINT8 ctrl=px[ src ^ 0 ];
+      ++src;
+
+      for(INT32 i=0;i<8;++i)
+      {
+         UINT8 p = px[ src ^ 0 ];
+
+         if(ctrl&0x80)
+         {
+            UINT8 real_byte;
+            p &= 0x7f;
+            real_byte = px[ (chardma_table_address+p*2+0) ^ 0 ];
+            ds += ProcessByte8(real_byte,ds);
+            real_byte = px[ (chardma_table_address+p*2+1) ^ 0 ];
+            ds += ProcessByte8(real_byte,ds);
+         }
+         else
+            ds += ProcessByte8(p,ds);
+         ++src;
+         ctrl<<=1;
+
+         if((ds-start)>=real_length)
+            return;
+      }
+   }
+}
+
+}
+
+// ---------------------------------------------------------------------------
+
+static UINT32 rng = 0x2545f491;
+
+static UINT32 rnd32()
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static UINT32 rnd_destination()
+{
+	switch (rnd32() & 7) {
+		case 0:  return CRAM_SIZE - 1 - (rnd32() & 0x3ff);			// just short of the end
+		case 1:  return CRAM_SIZE - 1 - (rnd32() & 0x3f);			// runs cross the end
+		case 2:
+		case 3:  return CRAM_SIZE + (rnd32() & 0x7fffff);			// past it
+		default: return rnd32() & (CRAM_SIZE - 1);
+	}
+}
+
+static UINT32 rnd_length()
+{
+	switch (rnd32() & 7) {
+		case 0:  return 1 + (rnd32() & 0xfffff);
+		case 1:  return 1 + (rnd32() & 0x1f);
+		case 2:  return 1 + (rnd32() & 0x1ff);
+		default: return 1 + (rnd32() & 0xffff);
+	}
+}
+
+int main()
+{
+	RomUser      = (UINT8 *)malloc(ROM_SIZE);
+	RamCRam      = (UINT32 *)malloc(CRAM_SIZE);
+	ref::RamCRam = (UINT32 *)malloc(CRAM_SIZE);
+
+	// literals, runs and table tokens, some stretches of runs alone
+	for (INT32 i = 0; i < ROM_SIZE; i++)
+		RomUser[i] = ((i >> 12) & 7) ? rnd32() : (rnd32() | 0x40) & 0x7f;
+	for (INT32 i = 0; i < CRAM_SIZE / 4; i++)
+		RamCRam[i] = ref::RamCRam[i] = rnd32();
+
+	for (INT32 n = 0; n < 3000; n++) {
+		INT32  alt    = n & 1;
+		UINT32 source = rnd32() & (ROM_SIZE / 2 - 1);
+		UINT32 dest   = rnd_destination();
+		UINT32 length = rnd_length();
+
+		chardma_table_address = rnd32() & (ROM_SIZE / 2 - 1);
+
+		if (alt) {
+			cps3_do_alt_char_dma(source, dest, length, chardma_table_address);
+			ref::cps3_do_alt_char_dma(source, dest, length);
+		} else {
+			cps3_do_char_dma(source, dest, length, chardma_table_address);
+			ref::cps3_do_char_dma(source, dest, length);
+		}
+
+		if (memcmp(RamCRam, ref::RamCRam, CRAM_SIZE) || lastb != ref::lastb || lastb2 != ref::lastb2 ||
+			last_normal_byte != ref::last_normal_byte) {
+			printf("cps3_chardma_test (BE_GFX %d): transfer %d differs, %s from %06x to %06x, %x bytes\n",
+				BE_GFX, n, alt ? "8bpp" : "normal", source, dest, length);
+			return 1;
+		}
+	}
+
+	printf("cps3_chardma_test (BE_GFX %d): ok\n", BE_GFX);
+	return 0;
+}
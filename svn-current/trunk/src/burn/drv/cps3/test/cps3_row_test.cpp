@@ -0,0 +1,195 @@
+// Checks the CPS3 tile row writers in cps3_row.inc against the per pixel
+// code they replaced, on random, sparse, empty and opaque rows with every
+// flip and both frame depths. "make -f makefile.libretro test" runs it once
+// as built for the host (SSE2 or NEON) and once with CPS3_ROW_SCALAR.
+
+#include "burnint.h"
+#include <stdio.h>
+
+#if !defined(CPS3_ROW_SCALAR)
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CPS3_ROW_SSE2	1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CPS3_ROW_NEON	1
+#endif
+#endif
+
+#include "../cps3_row.inc"
+
+#if defined(CPS3_ROW_SSE2)
+#define ROW_PATH	"sse2"
+#elif defined(CPS3_ROW_NEON)
+#define ROW_PATH	"neon"
+#else
+#define ROW_PATH	"scalar"
+#endif
+
+static UINT32 rng = 0x12345678;
+
+static UINT32 rnd32()
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+// a source byte, kind 0 random, 1 sparse, 2 empty, 3 opaque
+static UINT8 rnd_pixel(INT32 kind)
+{
+	switch (kind) {
+		case 0: return rnd32();
+		case 1: return (rnd32() & 7) ? 0 : rnd32();
+		case 2: return 0;
+	}
+	UINT8 p = rnd32();
+	return p ? p : 1;
+}
+
+// text tile source, two pixels per byte, each nibble follows the kind
+static void rnd_text_row(UINT8 * src, INT32 kind)
+{
+	for (INT32 i = 0; i < 8; i++)
+		src[i] = (rnd_pixel(kind) & 0x0f) | (rnd_pixel(kind) << 4);
+}
+
+// -- the code cps3_row.inc replaced -----------------------------------------
+
+template <typename T>
+static void ref_row8(T * dst, const UINT8 * src, const T * color, INT32 flipx)
+{
+#ifdef MSB_FIRST
+	const UINT8 b[4] = { src[1], src[3], src[5], src[7] };
+#else
+	const UINT8 b[4] = { src[2], src[0], src[6], src[4] };
+#endif
+
+	for (INT32 i = 0; i < 4; i++) {
+		INT32 x0 = flipx ? 7 - i * 2 : i * 2;
+		INT32 x1 = flipx ? 6 - i * 2 : i * 2 + 1;
+		if (b[i] & 0xf) dst[x0] = color[b[i] & 0xf];
+		if (b[i] >>  4) dst[x1] = color[b[i] >> 4];
+	}
+}
+
+static void ref_row16(UINT32 * dst, const UINT8 * src, UINT32 pal, INT32 flipx)
+{
+	for (INT32 i = 0; i < 16; i++)
+		if (src[i]) dst[flipx ? 15 - i : i] = src[i] | pal;
+}
+
+static void ref_shadow_row16(UINT32 * dst, const UINT8 * src)
+{
+	for (INT32 i = 0; i < 16; i++)
+		dst[i] |= (src[i] & 0x0f) << 13;
+}
+
+static void ref_alpha_row16(UINT32 * dst, const UINT8 * src, UINT32 bits)
+{
+	for (INT32 i = 0; i < 16; i++)
+		if (src[i]) dst[i] |= bits;
+}
+
+// ---------------------------------------------------------------------------
+
+// rows as cps3_drawgfxzoom_0 packs them for cps3_draw_row8
+static UINT32 text_bits(const UINT8 * src)
+{
+#ifdef MSB_FIRST
+	return src[1] | (src[3] << 8) | (src[5] << 16) | ((UINT32)src[7] << 24);
+#else
+	return src[2] | (src[0] << 8) | (src[6] << 16) | ((UINT32)src[4] << 24);
+#endif
+}
+
+// the row and a guard word on either side
+template <typename T>
+static INT32 check(const char * name, const T * a, const T * b, INT32 n, INT32 kind, INT32 flipx)
+{
+	for (INT32 i = 0; i < n + 2; i++) {
+		if (a[i] != b[i]) {
+			printf("cps3_row_test (%s): %s differs at %d, kind %d flipx %d: %08x, expected %08x\n",
+				ROW_PATH, name, i - 1, kind, flipx, (UINT32)a[i], (UINT32)b[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+template <typename T>
+static INT32 test_row8(const char * name)
+{
+	T color[16], dst[10], ref[10];
+	UINT8 src[8];
+
+	for (INT32 n = 0; n < 200000; n++) {
+		INT32 kind  = n & 3;
+		INT32 flipx = (n >> 2) & 1;
+
+		for (INT32 i = 0; i < 16; i++)
+			color[i] = (T)rnd32();
+		for (INT32 i = 0; i < 10; i++)
+			dst[i] = ref[i] = (T)rnd32();
+		rnd_text_row(src, kind);
+
+		cps3_draw_row8(dst + 1, text_bits(src), color, flipx);
+		ref_row8(ref + 1, src, color, flipx);
+		if (check(name, dst, ref, 8, kind, flipx))
+			return 1;
+	}
+
+	return 0;
+}
+
+static INT32 test_row16()
+{
+	UINT32 dst[18], ref[18];
+	UINT8 src[16];
+
+	for (INT32 n = 0; n < 200000; n++) {
+		INT32 kind  = n & 3;
+		INT32 flipx = (n >> 2) & 1;
+		UINT32 pal  = rnd32() & 0xffff00;
+		UINT32 bits = rnd32();
+
+		for (INT32 i = 0; i < 16; i++)
+			src[i] = rnd_pixel(kind);
+
+		for (INT32 i = 0; i < 18; i++)
+			dst[i] = ref[i] = rnd32();
+		cps3_draw_row16(dst + 1, src, pal, flipx);
+		ref_row16(ref + 1, src, pal, flipx);
+		if (check("row16", dst, ref, 16, kind, flipx))
+			return 1;
+
+		for (INT32 i = 0; i < 18; i++)
+			dst[i] = ref[i] = rnd32();
+		cps3_shadow_row16(dst + 1, src);
+		ref_shadow_row16(ref + 1, src);
+		if (check("shadow_row16", dst, ref, 16, kind, 0))
+			return 1;
+
+		for (INT32 i = 0; i < 18; i++)
+			dst[i] = ref[i] = rnd32();
+		cps3_alpha_row16(dst + 1, src, bits);
+		ref_alpha_row16(ref + 1, src, bits);
+		if (check("alpha_row16", dst, ref, 16, kind, 0))
+			return 1;
+	}
+
+	return 0;
+}
+
+int main()
+{
+	INT32 nRet = 0;
+
+	nRet |= test_row8<UINT16>("row8 16bpp");
+	nRet |= test_row8<UINT32>("row8 32bpp");
+	nRet |= test_row16();
+
+	printf("cps3_row_test (%s): %s\n", ROW_PATH, nRet ? "FAILED" : "ok");
+	return nRet;
+}
@@ -1,8 +1,11 @@
 #include "libretro.h"
 #include "burner.h"
+#include "burn_thread.h"
 
 #include <vector>
 #include <string>
+#include <stdarg.h>
+#include <stdio.h>
 
 #define FBA_VERSION "v0.2.97.29" // Sept 16, 2013 (SVN)
 
@@ -34,6 +37,7 @@ static void set_environment(void);
 static bool apply_dipswitch_from_variables();
 
 static void init_audio_buffer(INT32 sample_rate, INT32 fps);
+static void next_audio_segment(void);
 
 static retro_environment_t environ_cb;
 static retro_log_printf_t log_cb = log_dummy;
@@ -70,6 +74,14 @@ static bool remap_lr_p2         = false;
 static bool core_aspect_par     = false;
 
 extern INT32 EnableHiscores;
+#ifdef SH2_DRC
+extern INT32 EnableSh2Drc;
+#endif
+extern INT32 CharDmaCacheMB;
+#ifdef HAVE_THREADS
+extern INT32 EnableRenderPipeline;
+extern INT32 EnableAsyncCharDma;
+#endif
 
 #define STAT_NOFIND  0
 #define STAT_OK      1
@@ -91,8 +103,13 @@ static unsigned g_rom_count;
 
 static uint32_t *g_fba_frame;
 static int16_t *g_audio_buf;
-static INT32 nAudSegLen = 0;
+static INT32 nAudSegLen = 0;		// longest frame the buffer holds
+static INT32 nAudRate = 0;
+static INT32 nAudFPS = 6000;
+static INT32 nAudFrac = 0;			// rate * 100 left over from previous frames, in 1/nAudFPS samples
 static INT32 g_audio_samplerate = 48000;
+static INT32 g_color_depth = 2;
+static INT32 g_interpolation = 1;
 UINT32 nFrameskip = 1;
 
 // libretro globals
@@ -115,6 +132,17 @@ static const struct retro_variable var_fba_cpu_speed_adjust = { CORE_OPTION_NAME
 static const struct retro_variable var_fba_diagnostic_input = { CORE_OPTION_NAME "_diagnostic_input", "Diagnostic Input; None|Hold Start|Start + A + B|Hold Start + A + B|Start + L + R|Hold Start + L + R|Hold Select|Select + A + B|Hold Select + A + B|Select + L + R|Hold Select + L + R" };
 static const struct retro_variable var_fba_hiscores         = { CORE_OPTION_NAME "_hiscores", "Hiscores; enabled|disabled" };
 static const struct retro_variable var_fba_samplerate       = { CORE_OPTION_NAME "_samplerate", "Samplerate (need to quit retroarch); 48000|44100|32000|22050|11025" };
+static const struct retro_variable var_fba_color_depth      = { CORE_OPTION_NAME "_color_depth", "Color depth (need to quit retroarch); 16-bit|32-bit" };
+static const struct retro_variable var_fba_sound_interpolation = { CORE_OPTION_NAME "_sound_interpolation", "Sound interpolation; linear|cubic|band-limited|none" };
+static const struct retro_variable var_fba_char_dma_cache   = { CORE_OPTION_NAME "_char_dma_cache", "Decompressed graphics cache; disabled|16MB|32MB|64MB|128MB" };
+#ifdef SH2_DRC
+static const struct retro_variable var_fba_sh2_drc          = { CORE_OPTION_NAME "_sh2_drc", "SH-2 recompiler; enabled|disabled" };
+#endif
+#ifdef HAVE_THREADS
+static const struct retro_variable var_fba_render_threads   = { CORE_OPTION_NAME "_render_threads", "Render threads; 1|2|3|4|6|8" };
+static const struct retro_variable var_fba_render_pipeline  = { CORE_OPTION_NAME "_render_pipeline", "Render during emulation (1 frame latency); disabled|enabled" };
+static const struct retro_variable var_fba_async_char_dma   = { CORE_OPTION_NAME "_async_char_dma", "Decompress graphics in the background; disabled|enabled" };
+#endif
 
 // Mapping core options
 static const struct retro_variable var_fba_controls_p1    = { CORE_OPTION_NAME "_controls_p1", "P1 control scheme; gamepad|arcade" };
@@ -363,6 +391,17 @@ static void set_environment(void)
    vars_systems.push_back(&var_fba_controls_p2);
    vars_systems.push_back(&var_fba_hiscores);
     vars_systems.push_back(&var_fba_samplerate);
+   vars_systems.push_back(&var_fba_color_depth);
+   vars_systems.push_back(&var_fba_sound_interpolation);
+   vars_systems.push_back(&var_fba_char_dma_cache);
+#ifdef SH2_DRC
+   vars_systems.push_back(&var_fba_sh2_drc);
+#endif
+#ifdef HAVE_THREADS
+   vars_systems.push_back(&var_fba_render_threads);
+   vars_systems.push_back(&var_fba_render_pipeline);
+   vars_systems.push_back(&var_fba_async_char_dma);
+#endif
 
    // Add the remap L/R to R1/R2 options
    vars_systems.push_back(&var_fba_lr_controls_p1);
@@ -606,6 +645,26 @@ static bool open_archive(void)
 	return true;
 }
 
+static INT32 __cdecl libretro_bprintf(INT32 nStatus, const TCHAR* szFormat, ...)
+{
+   char buf[512];
+   va_list vp;
+   va_start(vp, szFormat);
+   INT32 rc = vsnprintf(buf, sizeof(buf), szFormat, vp);
+   va_end(vp);
+
+   enum retro_log_level level = RETRO_LOG_DEBUG;
+   switch (nStatus)
+   {
+      case PRINT_UI:        level = RETRO_LOG_INFO;  break;
+      case PRINT_IMPORTANT: level = RETRO_LOG_WARN;  break;
+      case PRINT_ERROR:     level = RETRO_LOG_ERROR; break;
+   }
+
+   log_cb(level, "%s", buf);
+   return rc;
+}
+
 void retro_init(void)
 {
    struct retro_log_callback log;
@@ -614,6 +673,8 @@ void retro_init(void)
    else
       log_cb = log_dummy;
 
+   bprintf = libretro_bprintf;
+
    BurnLibInit();
 }
 
@@ -628,6 +689,7 @@ void retro_deinit(void)
       BurnDrvExit();
    }
    driver_inited = false;
+   BurnThreadExit();
    BurnLibExit();
    if (g_fba_frame)
       free(g_fba_frame);
@@ -806,6 +868,41 @@ static void check_variables(void)
          EnableHiscores = false;
    }
 
+#ifdef SH2_DRC
+   var.key = var_fba_sh2_drc.key;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
+   {
+      if (strcmp(var.value, "enabled") == 0)
+         EnableSh2Drc = 1;
+      else
+         EnableSh2Drc = 0;
+   }
+#endif
+
+#ifdef HAVE_THREADS
+   var.key = var_fba_render_threads.key;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
+      BurnThreadInit(atoi(var.value));
+
+   var.key = var_fba_render_pipeline.key;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
+   {
+      if (strcmp(var.value, "enabled") == 0)
+         EnableRenderPipeline = 1;
+      else
+         EnableRenderPipeline = 0;
+   }
+
+   var.key = var_fba_async_char_dma.key;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
+   {
+      if (strcmp(var.value, "enabled") == 0)
+         EnableAsyncCharDma = 1;
+      else
+         EnableAsyncCharDma = 0;
+   }
+#endif
+
    var.key = var_fba_samplerate.key;
    if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
    {
@@ -822,6 +919,38 @@ static void check_variables(void)
       else
          g_audio_samplerate = 48000;
    }
+
+   var.key = var_fba_color_depth.key;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
+   {
+      if (strcmp(var.value, "32-bit") == 0)
+         g_color_depth = 4;
+      else
+         g_color_depth = 2;
+   }
+
+   var.key = var_fba_sound_interpolation.key;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
+   {
+      if (strcmp(var.value, "none") == 0)
+         g_interpolation = 0;
+      else if (strcmp(var.value, "cubic") == 0)
+         g_interpolation = 3;
+      else if (strcmp(var.value, "band-limited") == 0)
+         g_interpolation = 4;
+      else
+         g_interpolation = 1;
+   }
+   nInterpolation = g_interpolation;
+
+   var.key = var_fba_char_dma_cache.key;
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var))
+   {
+      if (strcmp(var.value, "disabled") == 0)
+         CharDmaCacheMB = 0;
+      else
+         CharDmaCacheMB = atoi(var.value);
+   }
 }
 
 // Set the input descriptors by combininng the 
@@ -847,6 +976,7 @@ void retro_run(void)
 
    InputMake();
 
+   next_audio_segment();
    ForceFrameStep(nCurrentFrame % nFrameskip == 0);
 
    unsigned drv_flags  = BurnDrvGetFlags();
@@ -985,7 +1115,8 @@ void retro_get_system_av_info(struct retro_system_av_info *info)
    if (game_aspect_x != 0 && game_aspect_y != 0 && !core_aspect_par)
       geom.aspect_ratio = (float)game_aspect_x / (float)game_aspect_y;
 
-   struct retro_system_timing timing = { (nBurnFPS / 100.0), (nBurnFPS / 100.0) * nAudSegLen };
+   // frames carry the fractional sample, so the rate is exact rather than fps * a rounded length
+   struct retro_system_timing timing = { (nBurnFPS / 100.0), (double)nAudRate };
 
    info->geometry = geom;
    info->timing   = timing;
@@ -1007,9 +1138,31 @@ static bool fba_init(unsigned driver, const char *game_zip_name)
    // Some game drivers won't initialize with an undefined nBurnSoundLen
    init_audio_buffer(nBurnSoundRate, 6000);
 
+   // the driver builds its palette for nBurnBpp, settle the format first
    nBurnBpp = 2;
+   if (g_color_depth == 4)
+   {
+      enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_XRGB8888;
+
+      if(environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
+      {
+         nBurnBpp = 4;
+         log_cb(RETRO_LOG_INFO, "Frontend supports XRGB888 - will use that instead of XRGB1555.\n");
+      }
+      else
+         log_cb(RETRO_LOG_WARN, "Frontend does not support XRGB888 - falling back to 16-bit colour.\n");
+   }
+#ifdef FRONTEND_SUPPORTS_RGB565
+   if(nBurnBpp == 2)
+   {
+      enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_RGB565;
+
+      if(environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt)) 
+         log_cb(RETRO_LOG_INFO, "Frontend supports RGB565 - will use that instead of XRGB1555.\n");
+   }
+#endif
    nFMInterpolation = 3;
-   nInterpolation = 1;
+   nInterpolation = g_interpolation;
 
    analog_controls_enabled = init_input();
 
@@ -1061,23 +1214,6 @@ static bool fba_init(unsigned driver, const char *game_zip_name)
 
    BurnRecalcPal();
 
-#ifdef FRONTEND_SUPPORTS_RGB565
-   if(nBurnBpp == 4)
-   {
-      enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_XRGB8888;
-
-      if(environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt))
-         log_cb(RETRO_LOG_INFO, "Frontend supports XRGB888 - will use that instead of XRGB1555.\n");
-   }
-   else
-   {
-      enum retro_pixel_format fmt = RETRO_PIXEL_FORMAT_RGB565;
-
-      if(environ_cb(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt)) 
-         log_cb(RETRO_LOG_INFO, "Frontend supports RGB565 - will use that instead of XRGB1555.\n");
-   }
-#endif
-
    return true;
 }
 
@@ -1088,15 +1224,27 @@ static void init_audio_buffer(INT32 sample_rate, INT32 fps)
 	// we don't change nBurnSoundRate, but we adjust some length
 	if ((sample_rate / 1000) > (fps / 100))
 		sample_rate = fps * 10;
-	nAudSegLen = (sample_rate * 100 + (fps >> 1)) / fps;
+	nAudRate = sample_rate;
+	nAudFPS = fps;
+	nAudFrac = 0;
+	nAudSegLen = (sample_rate * 100 + fps - 1) / fps;
 	if (g_audio_buf)
 		free(g_audio_buf);
-	g_audio_buf = (int16_t*)malloc(nAudSegLen<<2 * sizeof(int16_t));
-	memset(g_audio_buf, 0, nAudSegLen<<2 * sizeof(int16_t));
-	nBurnSoundLen = nAudSegLen;
+	g_audio_buf = (int16_t*)malloc(nAudSegLen * 2 * sizeof(int16_t));
+	memset(g_audio_buf, 0, nAudSegLen * 2 * sizeof(int16_t));
+	nBurnSoundLen = (sample_rate * 100) / fps;
 	pBurnSoundOut = g_audio_buf;
 }
 
+// rate * 100 / fps is rarely whole, so frames are a sample longer now and then
+// and the total never drifts from the rate reported to the frontend
+static void next_audio_segment(void)
+{
+	INT32 n = nAudRate * 100 + nAudFrac;
+	nBurnSoundLen = n / nAudFPS;
+	nAudFrac = n % nAudFPS;
+}
+
 static void extract_basename(char *buf, const char *path, size_t size)
 {
    const char *base = strrchr(path, '/');
@@ -31,12 +31,68 @@
 
 #include <stddef.h>
 
+#if defined(SH2_DRC)
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
 #include "burnint.h"
 #include "sh2_intf.h"
 
+// each can be set from the command line, the sh2 test builds every path
 #define BUSY_LOOP_HACKS 	1
 #define FAST_OP_FETCH		1
-#define USE_JUMPTABLE		0
+#ifndef USE_JUMPTABLE
+#define USE_JUMPTABLE		1
+#endif
+#ifndef USE_BLOCK_CACHE
+#define USE_BLOCK_CACHE		1
+#endif
+#define IDLE_LOOP_SKIP		1		// needs USE_BLOCK_CACHE
+#define COPY_LOOP_SKIP		1		// needs USE_BLOCK_CACHE
+
+// one indirect jump per instruction through the opcode table instead of
+// the two level switch, needs the gcc labels as values extension
+#ifndef USE_COMPUTED_GOTO
+#if USE_JUMPTABLE && defined(__GNUC__)
+#define USE_COMPUTED_GOTO	1
+#else
+#define USE_COMPUTED_GOTO	0
+#endif
+#endif
+
+// single steps through the opcode table without the computed goto, which
+// measures slower than the switch, so only the sh2 test builds it
+#ifndef USE_TABLE_STEP
+#define USE_TABLE_STEP		0
+#endif
+
+#if USE_BLOCK_CACHE && defined(SH2_DRC) && (defined(__x86_64__) || defined(_M_X64))
+#define USE_SH2_DRC			1
+#else
+#define USE_SH2_DRC			0
+#endif
+
+#if defined(SH2_DRC)
+INT32 EnableSh2Drc = 1;
+#endif
+
+// the context being run is one for the whole process. SH2_THREAD_CONTEXTS
+// keeps it per thread instead, so machines on different threads can each
+// run their own, at the price of every state access going through the
+// thread pointer. HAVE_THREADS, the video and char dma workers, is separate.
+#if defined(SH2_THREAD_CONTEXTS) && defined(__GNUC__) && defined(__ELF__) && !defined(__ANDROID__)
+#define SH2_TLS				__thread __attribute__((tls_model("initial-exec")))
+#elif defined(SH2_THREAD_CONTEXTS) && defined(__GNUC__) && !defined(__ANDROID__)
+#define SH2_TLS				__thread
+#elif defined(SH2_THREAD_CONTEXTS) && defined(_MSC_VER)
+#define SH2_TLS				__declspec(thread)
+#else
+#define SH2_TLS
+#endif
 
 #define SH2_INT_15		15
 
@@ -48,7 +104,7 @@
 
 	#define change_pc(newpc)															\
 		sh2->pc = (newpc);																\
-		pSh2Ext->opbase = pSh2Ext->MemMap[ (sh2->pc >> SH2_SHIFT) + SH2_WADD * 2 ];		\
+		pSh2Ext->opbase = SH2_MAP(SH2_MAP_FETCH, sh2->pc);								\
 		pSh2Ext->opbase -= (sh2->pc & ~SH2_PAGEM);
 
 #else
@@ -115,13 +171,16 @@ typedef struct
 	
 	int 	(*irq_callback)(int irqline);
 
+	INT32	sh2_icount_rest;	// slice cycles held back past the next timer event, not saved
+	UINT32	frame_base;			// cycle_counts at the last Sh2NewFrame, not saved
+
 } SH2;
 
-static SH2 * sh2;
+static SH2_TLS SH2 * sh2;
 
 static UINT32 sh2_GetTotalCycles()
 {
-	return sh2->cycle_counts + sh2->sh2_cycles_to_run - sh2->sh2_icount;
+	return sh2->cycle_counts + sh2->sh2_cycles_to_run - (sh2->sh2_icount + sh2->sh2_icount_rest);
 }
 
 static const int div_tab[4] = { 3, 5, 3, 0 };
@@ -158,16 +217,97 @@ static void sh2_internal_w(UINT32 offset, UINT32 data, UINT32 mem_mask);
 #define SH2_SHIFT		(SH2_BITS)				// Shift value = page bits
 #define SH2_PAGE_SIZE	(1 << SH2_BITS)			// Page size
 #define SH2_PAGEM		(SH2_PAGE_SIZE - 1)
-#define SH2_WADD		(SH2_PAGE_COUNT)		// Value to add for write section = Number of pages
-#define SH2_MASK		(SH2_WADD - 1)
+#define	SH2_MAXHANDLER	(16)					// the top two are the core's own
+
+// Two level map: the top 5 address bits pick a table of 2048 pages.
+// 0x00000000 ~ 0x3fffffff share one table, so the AM mirrors are folded
+// in the top level, and 128MB given to a single handler points at one
+// table filled with it. Only user space and 0xc0000000 need their own.
+
+#define SH2_MAP_SHIFT	(27)
+#define SH2_MAP_TOP		(1 << (32 - SH2_MAP_SHIFT))			// 128MB per top entry
+#define SH2_MAP_PAGES	(1 << (SH2_MAP_SHIFT - SH2_SHIFT))	// pages per table
+#define SH2_MAP_MIRROR	(0x40000000 >> SH2_MAP_SHIFT)		// top entries sharing the user table
+#define SH2_MAP_TABLES	(16)
+
+#define SH2_MAP_READ	(0)
+#define SH2_MAP_WRITE	(1)
+#define SH2_MAP_FETCH	(2)
+
+#define SH2_MAP(t, A)	(pSh2Ext->MapTop[t][(UINT32)(A) >> SH2_MAP_SHIFT][((UINT32)(A) >> SH2_SHIFT) & (SH2_MAP_PAGES - 1)])
+
+//-- decoded block cache ------------------------------------------
+// Straight-line runs of code are decoded once into micro-op arrays keyed
+// by pc. Only pages whose fetch memory has no direct write mapping are
+// cached, the driver calls Sh2InvalidateCode() when it rewrites them.
+
+#define SH2_BLOCK_BITS		(14)
+#define SH2_BLOCK_COUNT		(1 << SH2_BLOCK_BITS)
+#define SH2_BLOCK_OPS		(32)					// max ops per block, delay slot included
+#define SH2_UOP_COUNT		(SH2_BLOCK_COUNT * 8)
+#define SH2_LINE_SHIFT		(8)						// blocks never cross a 256 byte line
+#define SH2_LINE_SIZE		(1 << SH2_LINE_SHIFT)
+#define SH2_LINE_COUNT		(0x10000)				// hashed write generation per line
+#define SH2_LINE(a)			((((a) >> SH2_LINE_SHIFT) ^ ((a) >> 24)) & (SH2_LINE_COUNT - 1))
+
+#define SH2_BLOCK_EMPTY		(0xffffffff)
+#define SH2_BLOCK_DELAY		(1)						// last op sits in a delay slot
+#define SH2_BLOCK_IDLE		(2)						// poll loop branching back to its start
+#define SH2_BLOCK_IDLE_SEEN	(4)						// idle skip already reported
+#define SH2_BLOCK_WATCH		(8)						// covers a pc given to Sh2SetPcWatch()
+#define SH2_BLOCK_COPY		(16)					// copy or fill loop counted down by DT
+#define SH2_BLOCK_COPY_HELD	(32)					// copy loop not skippable until it is left
+#define SH2_BLOCK_HINT		(64)					// covers the pc given to Sh2SetIdleHint()
+#define SH2_BLOCK_HINT_SEEN	(128)					// missed hint already reported
+
+#define SH2_MAXWATCH		(2)
+
+typedef struct SH2UOP
+{
+	void	(*handler)(const struct SH2UOP * op);
+	UINT16	opcode;
+	UINT8	n;				// operands decoded once by sh2_block_build
+	UINT8	m;
+	UINT16	imm;
+} SH2UOP;
+
+typedef struct
+{
+	UINT32	pc;
+	UINT32	gen;
+	UINT32	uop;
+	UINT8	count;
+	UINT8	flags;
+#if USE_SH2_DRC
+	UINT8	hits;
+	UINT16	need;			// cycles the translated code needs to be entered
+	void	(*code)(void);
+#endif
+} SH2BLOCK;
 
-#define	SH2_MAXHANDLER	(8)
+typedef struct
+{
+	SH2BLOCK block[SH2_BLOCK_COUNT];
+	SH2UOP	uop[SH2_UOP_COUNT];
+	UINT32	uop_used;
+	UINT32	line_gen[SH2_LINE_COUNT];
+	UINT32	run_line;		// line of the block running, SH2_LINE_COUNT between blocks
+	UINT8	page_code[SH2_PAGE_COUNT];
+	UINT32	watch_pc[SH2_MAXWATCH];
+	pSh2PcWatch watch_cb[SH2_MAXWATCH];
+	UINT32	hint_pc;		// poll loop the driver knows of, SH2_BLOCK_EMPTY for none
+	UINT32	hint_address;
+#if USE_SH2_DRC
+	UINT8 *	code;
+	UINT32	code_used;
+#endif
+} SH2CACHE;
 
 
-typedef struct 
+typedef struct Sh2Context
 {
 	SH2	sh2;
-	unsigned char * MemMap[SH2_PAGE_COUNT * 3];
+	unsigned char ** MapTop[3][SH2_MAP_TOP];
 	pSh2ReadByteHandler ReadByte[SH2_MAXHANDLER];
 	pSh2WriteByteHandler WriteByte[SH2_MAXHANDLER];
 	pSh2ReadWordHandler ReadWord[SH2_MAXHANDLER];
@@ -177,10 +317,105 @@ typedef struct
 	
 	unsigned char * opbase;
 	int suspend;
+
+#if USE_BLOCK_CACHE
+	SH2CACHE cache;
+#endif
+
+	unsigned char * MapTable[SH2_MAP_TABLES][SH2_MAP_PAGES];
+	UINT8 MapFill[SH2_MAP_TABLES];	// handler + 1 for a single handler table, 0 otherwise
 } SH2EXT;
 
-static SH2EXT * pSh2Ext;
-static SH2EXT * Sh2Ext = NULL;
+static SH2_TLS SH2EXT * pSh2Ext;
+static SH2EXT * Sh2Ext = NULL;		// the contexts Sh2Open picks from
+static int nSh2Count = 0;
+
+#if USE_JUMPTABLE
+static void sh2_leaf_init(void);
+#endif
+
+#if USE_SH2_DRC
+static void sh2_drc_alloc(SH2EXT * ctx);
+static void sh2_drc_free(SH2EXT * ctx);
+#endif
+
+#if USE_BLOCK_CACHE
+
+static void sh2_cache_flush(void)
+{
+	SH2CACHE * c = &pSh2Ext->cache;
+
+	for (int i = 0; i < SH2_BLOCK_COUNT; i++)
+		c->block[i].pc = SH2_BLOCK_EMPTY;
+	c->uop_used = 0;
+	c->run_line = SH2_LINE_COUNT;
+	memset(c->page_code, 0, sizeof(c->page_code));
+#if USE_SH2_DRC
+	c->code_used = 0;
+#endif
+}
+
+// a fetch mapping changed, drop everything if code was cached there
+static void sh2_cache_remap(unsigned int nStart, unsigned int nEnd)
+{
+	for (unsigned long long i = (nStart & ~SH2_PAGEM); i <= nEnd; i += SH2_PAGE_SIZE) {
+		if (pSh2Ext->cache.page_code[(i & AM) >> SH2_SHIFT]) {
+			sh2_cache_flush();
+			break;
+		}
+	}
+}
+
+#endif
+
+void Sh2InvalidateCode(unsigned int nStart, unsigned int nEnd)
+{
+#if USE_BLOCK_CACHE
+	UINT32 * line_gen = pSh2Ext->cache.line_gen;
+
+	nStart &= AM;
+	nEnd &= AM;
+	for (unsigned long long i = (nStart & ~(SH2_LINE_SIZE - 1)); i <= nEnd; i += SH2_LINE_SIZE) {
+		line_gen[SH2_LINE(i)]++;
+
+		// a store rewrote the block running, end it after this op by
+		// parking the rest of the slice where sh2_event_check finds it
+		if (SH2_LINE(i) == pSh2Ext->cache.run_line && sh2->sh2_icount > 0) {
+			sh2->sh2_icount_rest += sh2->sh2_icount;
+			sh2->sh2_icount = 0;
+		}
+	}
+#endif
+}
+
+int Sh2SetPcWatch(int i, unsigned int nPc, pSh2PcWatch pCallback)
+{
+#if USE_BLOCK_CACHE
+	if (i >= SH2_MAXWATCH) return 1;
+
+	pSh2Ext->cache.watch_pc[i] = nPc & AM;
+	pSh2Ext->cache.watch_cb[i] = pCallback;
+
+	// blocks are flagged when they are built
+	sh2_cache_flush();
+	return 0;
+#else
+	return 1;
+#endif
+}
+
+int Sh2SetIdleHint(unsigned int nPc, unsigned int nAddress)
+{
+#if USE_BLOCK_CACHE && IDLE_LOOP_SKIP
+	pSh2Ext->cache.hint_pc = nPc & AM;
+	pSh2Ext->cache.hint_address = nAddress;
+
+	sh2_cache_flush();
+	return 0;
+#else
+	return 1;
+#endif
+}
 
 /* SH-2 Memory Map:
  * 0x00000000 ~ 0x07ffffff : user
@@ -196,94 +431,119 @@ static SH2EXT * Sh2Ext = NULL;
  * 0xe0000000 ~ 0xffffffff : internal mem
  */
  
-int Sh2MapMemory(unsigned char* pMemory, unsigned int nStart, unsigned int nEnd, int nType)
-{
-	unsigned char* Ptr = pMemory - nStart;
-	unsigned char** pMemMap = pSh2Ext->MemMap + (nStart >> SH2_SHIFT);
-	int need_mirror = (nStart < 0x08000000) ? 1 : 0;
-		
-	for (unsigned long long i = (nStart & ~SH2_PAGEM); i <= nEnd; i += SH2_PAGE_SIZE, pMemMap++) {
-		if (nType & 0x01 /*SM_READ*/)  pMemMap[0] 			= Ptr + i;
-		if (nType & 0x02 /*SM_WRITE*/) pMemMap[SH2_WADD] 	= Ptr + i;
-		if (nType & 0x04 /*SM_FETCH*/) pMemMap[SH2_WADD*2]	= Ptr + i;
-		
-		if ( need_mirror ) {
-			if (nType & 0x01 /*SM_READ*/)  {
-				pMemMap[0 + (0x08000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[0 + (0x10000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[0 + (0x18000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[0 + (0x20000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[0 + (0x28000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[0 + (0x30000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[0 + (0x38000000 >> SH2_SHIFT)] = Ptr + i;
-			}
-			if (nType & 0x02 /*SM_WRITE*/) {
-				pMemMap[SH2_WADD + (0x08000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD + (0x10000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD + (0x18000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD + (0x20000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD + (0x28000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD + (0x30000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD + (0x38000000 >> SH2_SHIFT)] = Ptr + i;
-			}
-			if (nType & 0x04 /*SM_FETCH*/) {
-				pMemMap[SH2_WADD*2 + (0x08000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD*2 + (0x10000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD*2 + (0x18000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD*2 + (0x20000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD*2 + (0x28000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD*2 + (0x30000000 >> SH2_SHIFT)] = Ptr + i;
-				pMemMap[SH2_WADD*2 + (0x38000000 >> SH2_SHIFT)] = Ptr + i;
-			}
+// a table no top entry points at any more, table 0 is the handler 0 one
+static int sh2_map_alloc(void)
+{
+	for (int n = 1; n < SH2_MAP_TABLES; n++) {
+		int used = 0;
+		for (int t = 0; t < 3 && !used; t++)
+			for (int s = 0; s < SH2_MAP_TOP; s++)
+				if (pSh2Ext->MapTop[t][s] == pSh2Ext->MapTable[n]) {
+					used = 1;
+					break;
+				}
+		if (!used) {
+			pSh2Ext->MapFill[n] = 0;
+			return n;
 		}
 	}
-	return 0;
+
+	bprintf(PRINT_ERROR, "SH2: out of memory map tables\n");
+	return -1;
 }
 
-int Sh2MapHandler(uintptr_t nHandler, unsigned int nStart, unsigned int nEnd, int nType)
+static unsigned char ** sh2_map_single(int nHandler)
 {
-	unsigned char** pMemMap = pSh2Ext->MemMap + (nStart >> SH2_SHIFT);
-	int need_mirror = (nStart < 0x08000000) ? 1 : 0;
-	
-	for (unsigned long long i = (nStart & ~SH2_PAGEM); i <= nEnd; i += SH2_PAGE_SIZE, pMemMap++) {
-		if (nType & 0x01 /*SM_READ*/)  pMemMap[0]		 	= (unsigned char*)nHandler;
-		if (nType & 0x02 /*SM_WRITE*/) pMemMap[SH2_WADD] 	= (unsigned char*)nHandler;
-		if (nType & 0x04 /*SM_FETCH*/) pMemMap[SH2_WADD*2]	= (unsigned char*)nHandler;
-		
-		if ( need_mirror ) {
-			if (nType & 0x01 /*SM_READ*/)  {
-				pMemMap[0 + (0x08000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[0 + (0x10000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[0 + (0x18000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[0 + (0x20000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[0 + (0x28000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[0 + (0x30000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[0 + (0x38000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-			}
-			if (nType & 0x02 /*SM_WRITE*/) {
-				pMemMap[SH2_WADD + (0x08000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD + (0x10000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD + (0x18000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD + (0x20000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD + (0x28000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD + (0x30000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD + (0x38000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-			}
-			if (nType & 0x04 /*SM_FETCH*/) {
-				pMemMap[SH2_WADD*2 + (0x08000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD*2 + (0x10000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD*2 + (0x18000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD*2 + (0x20000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD*2 + (0x28000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD*2 + (0x30000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
-				pMemMap[SH2_WADD*2 + (0x38000000 >> SH2_SHIFT)] = (unsigned char*)nHandler;
+	int n;
+
+	for (n = 0; n < SH2_MAP_TABLES; n++)
+		if (pSh2Ext->MapFill[n] == nHandler + 1)
+			return pSh2Ext->MapTable[n];
+
+	if ((n = sh2_map_alloc()) < 0)
+		return NULL;
+
+	for (int i = 0; i < SH2_MAP_PAGES; i++)
+		pSh2Ext->MapTable[n][i] = (unsigned char *)(uintptr_t)nHandler;
+	pSh2Ext->MapFill[n] = nHandler + 1;
+
+	return pSh2Ext->MapTable[n];
+}
+
+static void sh2_map_top(int t, int s, unsigned char ** pTable)
+{
+	if (s < SH2_MAP_MIRROR) {
+		for (int i = 0; i < SH2_MAP_MIRROR; i++)
+			pSh2Ext->MapTop[t][i] = pTable;
+	} else
+		pSh2Ext->MapTop[t][s] = pTable;
+}
+
+// copy a shared single handler table before single pages change
+static unsigned char ** sh2_map_private(int t, int s)
+{
+	unsigned char ** pTable = pSh2Ext->MapTop[t][s];
+	int n = (int)((pTable - pSh2Ext->MapTable[0]) / SH2_MAP_PAGES);
+
+	if (pSh2Ext->MapFill[n] == 0)
+		return pTable;
+
+	if ((n = sh2_map_alloc()) < 0)
+		return NULL;
+
+	memcpy(pSh2Ext->MapTable[n], pTable, sizeof(pSh2Ext->MapTable[n]));
+	sh2_map_top(t, s, pSh2Ext->MapTable[n]);
+
+	return pSh2Ext->MapTable[n];
+}
+
+// pMemory is NULL when mapping handler nHandler
+static int sh2_map(unsigned char* pMemory, int nHandler, unsigned int nStart, unsigned int nEnd, int nType)
+{
+	unsigned char* Ptr = pMemory ? pMemory - nStart : NULL;
+
+#if USE_BLOCK_CACHE
+	if (nType & 0x04 /*SM_FETCH*/) sh2_cache_remap(nStart, nEnd);
+#endif
+
+	for (int t = 0; t < 3; t++) {
+		if (!(nType & (1 << t)))	// SM_READ, SM_WRITE, SM_FETCH
+			continue;
+
+		for (unsigned long long i = (nStart & ~SH2_PAGEM); i <= nEnd; ) {
+			int s = (int)(i >> SH2_MAP_SHIFT);
+			unsigned long long next = (unsigned long long)(s + 1) << SH2_MAP_SHIFT;
+			unsigned char ** pTable;
+
+			if (pMemory == NULL && (i & ((1 << SH2_MAP_SHIFT) - 1)) == 0 && nEnd >= next - 1) {
+				if ((pTable = sh2_map_single(nHandler)) == NULL)
+					return 1;
+				sh2_map_top(t, s, pTable);
+				i = next;
+				continue;
 			}
+
+			if ((pTable = sh2_map_private(t, s)) == NULL)
+				return 1;
+
+			for (; i <= nEnd && i < next; i += SH2_PAGE_SIZE)
+				pTable[(i >> SH2_SHIFT) & (SH2_MAP_PAGES - 1)] = pMemory ? Ptr + i : (unsigned char *)(uintptr_t)nHandler;
 		}
-		
 	}
+
 	return 0;
 }
 
+int Sh2MapMemory(unsigned char* pMemory, unsigned int nStart, unsigned int nEnd, int nType)
+{
+	return sh2_map(pMemory, 0, nStart, nEnd, nType);
+}
+
+int Sh2MapHandler(uintptr_t nHandler, unsigned int nStart, unsigned int nEnd, int nType)
+{
+	return sh2_map(NULL, (int)nHandler, nStart, nEnd, nType);
+}
+
 int Sh2SetReadByteHandler(int i, pSh2ReadByteHandler pHandler)
 {
 	if (i >= SH2_MAXHANDLER) return 1;
@@ -366,10 +626,16 @@ void __fastcall Sh2EmptyWriteLong(unsigned int, unsigned int) { }
 int Sh2Exit(void)
 {
 	if (Sh2Ext) {
+#if USE_SH2_DRC
+		for (int i = 0; i < nSh2Count; i++)
+			sh2_drc_free(Sh2Ext + i);
+#endif
+		if (pSh2Ext >= Sh2Ext && pSh2Ext < Sh2Ext + nSh2Count)
+			Sh2SetContext(NULL);
 		free(Sh2Ext);
 		Sh2Ext = NULL;
 	}
-	pSh2Ext = NULL;
+	nSh2Count = 0;
 	
 	return 0;
 }
@@ -400,6 +666,46 @@ static cpu_core_config Sh2CheatCpuConfig =
 	0
 };
 
+// a zeroed context gets a cache, handler 0 everywhere and the on chip
+// modules, it is left current
+static void sh2_context_init(SH2EXT * ctx)
+{
+	Sh2SetContext(ctx);
+
+#if USE_BLOCK_CACHE
+	sh2_cache_flush();
+	pSh2Ext->cache.hint_pc = SH2_BLOCK_EMPTY;
+#endif
+
+#if USE_SH2_DRC
+	sh2_drc_alloc(ctx);
+#endif
+
+	// everything starts out on handler 0
+	pSh2Ext->MapFill[0] = 1;
+	for (int t = 0; t < 3; t++)
+		for (int s = 0; s < SH2_MAP_TOP; s++)
+			pSh2Ext->MapTop[t][s] = pSh2Ext->MapTable[0];
+
+	Sh2MapHandler(SH2_MAXHANDLER - 1, 0xE0000000, 0xFFFFFFFF, 0x07);
+	Sh2MapHandler(SH2_MAXHANDLER - 2, 0x40000000, 0xBFFFFFFF, 0x07);
+//	Sh2MapHandler(SH2_MAXHANDLER - 3, 0xC0000000, 0xDFFFFFFF, 0x07);
+
+	Sh2SetReadByteHandler (SH2_MAXHANDLER - 1, Sh2InnerReadByte);
+	Sh2SetReadWordHandler (SH2_MAXHANDLER - 1, Sh2InnerReadWord);
+	Sh2SetReadLongHandler (SH2_MAXHANDLER - 1, Sh2InnerReadLong);
+	Sh2SetWriteByteHandler(SH2_MAXHANDLER - 1, Sh2InnerWriteByte);		
+	Sh2SetWriteWordHandler(SH2_MAXHANDLER - 1, Sh2InnerWriteWord);
+	Sh2SetWriteLongHandler(SH2_MAXHANDLER - 1, Sh2InnerWriteLong);
+	
+	Sh2SetReadByteHandler (SH2_MAXHANDLER - 2, Sh2EmptyReadByte);
+	Sh2SetReadWordHandler (SH2_MAXHANDLER - 2, Sh2EmptyReadWord);
+	Sh2SetReadLongHandler (SH2_MAXHANDLER - 2, Sh2EmptyReadLong);
+	Sh2SetWriteByteHandler(SH2_MAXHANDLER - 2, Sh2EmptyWriteByte);		
+	Sh2SetWriteWordHandler(SH2_MAXHANDLER - 2, Sh2EmptyWriteWord);
+	Sh2SetWriteLongHandler(SH2_MAXHANDLER - 2, Sh2EmptyWriteLong);
+}
+
 int Sh2Init(int nCount)
 {
 	Sh2Ext = (SH2EXT *)malloc(sizeof(SH2EXT) * nCount);
@@ -408,30 +714,15 @@ int Sh2Init(int nCount)
 		return 1;
 	}
 	memset(Sh2Ext, 0, sizeof(SH2EXT) * nCount);
+	nSh2Count = nCount;
+
+#if USE_JUMPTABLE
+	sh2_leaf_init();
+#endif
 
 	// init default memory handler
 	for (int i=0; i<nCount; i++) {
-		pSh2Ext = Sh2Ext + i;
-		//sh2 = & pSh2Ext->sh2;
-
-		Sh2MapHandler(SH2_MAXHANDLER - 1, 0xE0000000, 0xFFFFFFFF, 0x07);
-		Sh2MapHandler(SH2_MAXHANDLER - 2, 0x40000000, 0xBFFFFFFF, 0x07);
-//		Sh2MapHandler(SH2_MAXHANDLER - 3, 0xC0000000, 0xDFFFFFFF, 0x07);
-
-		Sh2SetReadByteHandler (SH2_MAXHANDLER - 1, Sh2InnerReadByte);
-		Sh2SetReadWordHandler (SH2_MAXHANDLER - 1, Sh2InnerReadWord);
-		Sh2SetReadLongHandler (SH2_MAXHANDLER - 1, Sh2InnerReadLong);
-		Sh2SetWriteByteHandler(SH2_MAXHANDLER - 1, Sh2InnerWriteByte);		
-		Sh2SetWriteWordHandler(SH2_MAXHANDLER - 1, Sh2InnerWriteWord);
-		Sh2SetWriteLongHandler(SH2_MAXHANDLER - 1, Sh2InnerWriteLong);
-		
-		Sh2SetReadByteHandler (SH2_MAXHANDLER - 2, Sh2EmptyReadByte);
-		Sh2SetReadWordHandler (SH2_MAXHANDLER - 2, Sh2EmptyReadWord);
-		Sh2SetReadLongHandler (SH2_MAXHANDLER - 2, Sh2EmptyReadLong);
-		Sh2SetWriteByteHandler(SH2_MAXHANDLER - 2, Sh2EmptyWriteByte);		
-		Sh2SetWriteWordHandler(SH2_MAXHANDLER - 2, Sh2EmptyWriteWord);
-		Sh2SetWriteLongHandler(SH2_MAXHANDLER - 2, Sh2EmptyWriteLong);
-
+		sh2_context_init(Sh2Ext + i);
 		CpuCheatRegister(i, &Sh2CheatCpuConfig);
 	}
 
@@ -440,55 +731,102 @@ int Sh2Init(int nCount)
 
 void Sh2Open(const int i)
 {
-	pSh2Ext = Sh2Ext + i;
-	sh2 = & (pSh2Ext->sh2);
+	Sh2SetContext(Sh2Ext + i);
 }
 
 void Sh2Close(void) { }
-int Sh2GetActive(void) { return 0; }
 
-void Sh2Reset(unsigned int pc, unsigned r15)
+int Sh2GetActive(void)
 {
-	memset(sh2, 0, sizeof(SH2) - 4);
-
-	sh2->pc = pc;
-	sh2->r[15] = r15;
-	sh2->sr = I;
-	
-	change_pc(sh2->pc & AM);
+	if (Sh2Ext && pSh2Ext >= Sh2Ext && pSh2Ext < Sh2Ext + nSh2Count)
+		return (int)(pSh2Ext - Sh2Ext);
 
-	sh2->internal_irq_level = -1;
+	return -1;
 }
 
-//----------------------------------------------------------------
+Sh2Context * Sh2CreateContext(void)
+{
+	SH2EXT * ctx = (SH2EXT *)malloc(sizeof(SH2EXT));
+	if (ctx == NULL)
+		return NULL;
+	memset(ctx, 0, sizeof(SH2EXT));
+
+#if USE_JUMPTABLE
+	sh2_leaf_init();
+#endif
+
+	SH2EXT * prev = pSh2Ext;
+	sh2_context_init(ctx);
+	Sh2SetContext(prev);
+
+	return ctx;
+}
 
-unsigned char program_read_byte_32be(unsigned int /*A*/)
+void Sh2DestroyContext(Sh2Context * ctx)
 {
-	return 0;	
+	if (ctx == NULL)
+		return;
+
+#if USE_SH2_DRC
+	sh2_drc_free(ctx);
+#endif
+
+	if (pSh2Ext == ctx)
+		Sh2SetContext(NULL);
+	free(ctx);
 }
 
-unsigned short program_read_word_32be(unsigned int /*A*/)
+Sh2Context * Sh2SetContext(Sh2Context * ctx)
 {
-	return 0;
+	SH2EXT * prev = pSh2Ext;
+
+	pSh2Ext = ctx;
+	sh2 = ctx ? &ctx->sh2 : NULL;
+
+	return prev;
 }
 
-unsigned int program_read_dword_32be(unsigned int /*A*/)
+Sh2Context * Sh2GetContext(void)
 {
-	return 0;
+	return pSh2Ext;
 }
 
-void program_write_byte_32be(unsigned int /*A*/, unsigned char /*V*/)
+int Sh2ContextRun(Sh2Context * ctx, int cycles)
 {
+	SH2EXT * prev = Sh2SetContext(ctx);
+	int ran = Sh2Run(cycles);
+	Sh2SetContext(prev);
+
+	return ran;
 }
 
-void program_write_word_32be(unsigned int /*A*/, unsigned short /*V*/)
+void Sh2ContextSetIRQLine(Sh2Context * ctx, const int line, const int state)
 {
+	SH2EXT * prev = Sh2SetContext(ctx);
+	Sh2SetIRQLine(line, state);
+	Sh2SetContext(prev);
 }
 
-void program_write_dword_32be(unsigned int /*A*/, unsigned int /*V*/)
+void Sh2Reset(unsigned int pc, unsigned r15)
 {
+	memset(sh2, 0, sizeof(SH2) - 4);
+	sh2->frame_base = 0;
+
+	sh2->pc = pc;
+	sh2->r[15] = r15;
+	sh2->sr = I;
+	
+	change_pc(sh2->pc & AM);
+
+	sh2->internal_irq_level = -1;
+
+#if USE_BLOCK_CACHE
+	sh2_cache_flush();
+#endif
 }
 
+//----------------------------------------------------------------
+
 //pSh2Ext->opbase
 
 #if FAST_OP_FETCH
@@ -504,7 +842,7 @@ void program_write_dword_32be(unsigned int /*A*/, unsigned int /*V*/)
 SH2_INLINE unsigned short cpu_readop16(unsigned int A)
 {
 	unsigned char * pr;
-	pr = pSh2Ext->MemMap[ (A >> SH2_SHIFT) + SH2_WADD * 2 ];
+	pr = SH2_MAP(SH2_MAP_FETCH, A);
 	if ( (unsigned int)pr >= SH2_MAXHANDLER ) {
 #ifndef MSB_FIRST
 		A ^= 2;
@@ -526,7 +864,7 @@ SH2_INLINE UINT8 RB(UINT32 A)
 	return program_read_byte_32be(A & AM); */
 	
 	unsigned char * pr;
-	pr = pSh2Ext->MemMap[ A >> SH2_SHIFT ];
+	pr = SH2_MAP(SH2_MAP_READ, A);
 	if ( (uintptr_t)pr >= SH2_MAXHANDLER ) {
 #ifndef MSB_FIRST
 		A ^= 3;
@@ -544,7 +882,7 @@ SH2_INLINE UINT16 RW(UINT32 A)
 	return program_read_word_32be(A & AM); */
 	
 	unsigned char * pr;
-	pr = pSh2Ext->MemMap[ A >> SH2_SHIFT ];
+	pr = SH2_MAP(SH2_MAP_READ, A);
 	if ( (uintptr_t)pr >= SH2_MAXHANDLER ) {
 #ifndef MSB_FIRST
 		A ^= 2;
@@ -559,7 +897,7 @@ SH2_INLINE UINT16 OPRW(UINT32 A)
 {
 
 	unsigned char * pr;
-	pr = pSh2Ext->MemMap[ (A >> SH2_SHIFT) + SH2_WADD * 2 ];
+	pr = SH2_MAP(SH2_MAP_FETCH, A);
 	if ( (uintptr_t)pr >= SH2_MAXHANDLER ) {
 #ifndef MSB_FIRST
 		A ^= 2;
@@ -578,7 +916,7 @@ SH2_INLINE UINT32 RL(UINT32 A)
 	return program_read_dword_32be(A & AM);		*/
 	
 	unsigned char * pr;
-	pr = pSh2Ext->MemMap[ A >> SH2_SHIFT ];
+	pr = SH2_MAP(SH2_MAP_READ, A);
 	if ( (uintptr_t)pr >= SH2_MAXHANDLER ) {
 		//return (pr[(A & SH2_PAGEM) + 0] << 24) | (pr[(A & SH2_PAGEM) + 1] << 16) | (pr[(A & SH2_PAGEM) + 2] <<  8) | (pr[(A & SH2_PAGEM) + 3] <<  0);
 		return *((unsigned int *)(pr + (A & SH2_PAGEM)));
@@ -594,7 +932,7 @@ SH2_INLINE void WB(UINT32 A, UINT8 V)
 	program_write_byte_32be(A & AM,V); */
 	
 	unsigned char* pr;
-	pr = pSh2Ext->MemMap[(A >> SH2_SHIFT) + SH2_WADD];
+	pr = SH2_MAP(SH2_MAP_WRITE, A);
 	if ((uintptr_t)pr >= SH2_MAXHANDLER) {
 #ifndef MSB_FIRST
 		A ^= 3;
@@ -613,7 +951,7 @@ SH2_INLINE void WW(UINT32 A, UINT16 V)
 	program_write_word_32be(A & AM,V); */
 
 	unsigned char * pr;
-	pr = pSh2Ext->MemMap[(A >> SH2_SHIFT) + SH2_WADD];
+	pr = SH2_MAP(SH2_MAP_WRITE, A);
 	if ((uintptr_t)pr >= SH2_MAXHANDLER) {
 #ifndef MSB_FIRST
 		A ^= 2;
@@ -631,7 +969,7 @@ SH2_INLINE void WL(UINT32 A, UINT32 V)
 	if (A >= 0x40000000) return;
 	program_write_dword_32be(A & AM,V); */
 	unsigned char * pr;
-	pr = pSh2Ext->MemMap[(A >> SH2_SHIFT) + SH2_WADD];
+	pr = SH2_MAP(SH2_MAP_WRITE, A);
 	if ((uintptr_t)pr >= SH2_MAXHANDLER) {
 		*((unsigned int *)(pr + (A & SH2_PAGEM))) = (unsigned int)V;
 		return;
@@ -704,12 +1042,6 @@ do {											\
 } while(0)
 
 
-#if USE_JUMPTABLE
-
-	#include "sh2op.c"
-	
-#else
-
 /*  code                 cycles  t-bit
  *  0011 nnnn mmmm 1100  1       -
  *  ADD     Rm,Rn
@@ -2630,72 +2962,1089 @@ SH2_INLINE void op1111(UINT16 /*opcode*/)
 	NOP();
 }
 
-#endif	// USE_JUMPTABLE
+#if USE_JUMPTABLE
 
 /*****************************************************************************
- *  MAME CPU INTERFACE
+ *  OPCODE TABLE
+ *
+ *  Every opcode maps to a leaf that runs exactly one instruction, so the
+ *  dispatch costs a single indirect jump. The table holds leaf indices
+ *  rather than pointers to keep it at 64KB; the same index selects the
+ *  leaf function (recompiler calls), the uop leaf (block cache) or the
+ *  computed goto label in Sh2Run.
  *****************************************************************************/
 
-static void sh2_timer_resync(void)
-{
-	int divider = div_tab[(sh2->m[5] >> 8) & 3];
-	UINT32 cur_time = sh2_GetTotalCycles();
+#define IMM4	(opcode & 0x0f)
+#define IMM8	(opcode & 0xff)
+#define IMM12	(opcode & 0xfff)
+
+#define SH2_LEAF_LIST(OP)							\
+	OP(NOP,			NOP())							\
+	OP(STCSR,		STCSR(Rn))						\
+	OP(BSRF,		BSRF(Rn))						\
+	OP(MOVBS0,		MOVBS0(Rm, Rn))					\
+	OP(MOVWS0,		MOVWS0(Rm, Rn))					\
+	OP(MOVLS0,		MOVLS0(Rm, Rn))					\
+	OP(MULL,		MULL(Rm, Rn))					\
+	OP(CLRT,		CLRT())							\
+	OP(STSMACH,		STSMACH(Rn))					\
+	OP(RTS,			RTS())							\
+	OP(MOVBL0,		MOVBL0(Rm, Rn))					\
+	OP(MOVWL0,		MOVWL0(Rm, Rn))					\
+	OP(MOVLL0,		MOVLL0(Rm, Rn))					\
+	OP(MAC_L,		MAC_L(Rm, Rn))					\
+	OP(STCGBR,		STCGBR(Rn))						\
+	OP(SETT,		SETT())							\
+	OP(DIV0U,		DIV0U())						\
+	OP(STSMACL,		STSMACL(Rn))					\
+	OP(SLEEP,		SLEEP())						\
+	OP(STCVBR,		STCVBR(Rn))						\
+	OP(BRAF,		BRAF(Rn))						\
+	OP(CLRMAC,		CLRMAC())						\
+	OP(MOVT,		MOVT(Rn))						\
+	OP(STSPR,		STSPR(Rn))						\
+	OP(RTE,			RTE())							\
+	OP(MOVLS4,		MOVLS4(Rm, IMM4, Rn))		\
+	OP(MOVBS,		MOVBS(Rm, Rn))					\
+	OP(MOVWS,		MOVWS(Rm, Rn))					\
+	OP(MOVLS,		MOVLS(Rm, Rn))					\
+	OP(MOVBM,		MOVBM(Rm, Rn))					\
+	OP(MOVWM,		MOVWM(Rm, Rn))					\
+	OP(MOVLM,		MOVLM(Rm, Rn))					\
+	OP(DIV0S,		DIV0S(Rm, Rn))					\
+	OP(TST,			TST(Rm, Rn))					\
+	OP(AND,			AND(Rm, Rn))					\
+	OP(XOR,			XOR(Rm, Rn))					\
+	OP(OR,			OR(Rm, Rn))						\
+	OP(CMPSTR,		CMPSTR(Rm, Rn))					\
+	OP(XTRCT,		XTRCT(Rm, Rn))					\
+	OP(MULU,		MULU(Rm, Rn))					\
+	OP(MULS,		MULS(Rm, Rn))					\
+	OP(CMPEQ,		CMPEQ(Rm, Rn))					\
+	OP(CMPHS,		CMPHS(Rm, Rn))					\
+	OP(CMPGE,		CMPGE(Rm, Rn))					\
+	OP(DIV1,		DIV1(Rm, Rn))					\
+	OP(DMULU,		DMULU(Rm, Rn))					\
+	OP(CMPHI,		CMPHI(Rm, Rn))					\
+	OP(CMPGT,		CMPGT(Rm, Rn))					\
+	OP(SUB,			SUB(Rm, Rn))					\
+	OP(SUBC,		SUBC(Rm, Rn))					\
+	OP(SUBV,		SUBV(Rm, Rn))					\
+	OP(ADD,			ADD(Rm, Rn))					\
+	OP(DMULS,		DMULS(Rm, Rn))					\
+	OP(ADDC,		ADDC(Rm, Rn))					\
+	OP(ADDV,		ADDV(Rm, Rn))					\
+	OP(SHLL,		SHLL(Rn))						\
+	OP(SHLR,		SHLR(Rn))						\
+	OP(STSMMACH,	STSMMACH(Rn))					\
+	OP(STCMSR,		STCMSR(Rn))						\
+	OP(ROTL,		ROTL(Rn))						\
+	OP(ROTR,		ROTR(Rn))						\
+	OP(LDSMMACH,	LDSMMACH(Rn))					\
+	OP(LDCMSR,		LDCMSR(Rn))						\
+	OP(SHLL2,		SHLL2(Rn))						\
+	OP(SHLR2,		SHLR2(Rn))						\
+	OP(LDSMACH,		LDSMACH(Rn))					\
+	OP(JSR,			JSR(Rn))						\
+	OP(LDCSR,		LDCSR(Rn))						\
+	OP(MAC_W,		MAC_W(Rm, Rn))					\
+	OP(DT,			DT(Rn))							\
+	OP(CMPPZ,		CMPPZ(Rn))						\
+	OP(STSMMACL,	STSMMACL(Rn))					\
+	OP(STCMGBR,		STCMGBR(Rn))					\
+	OP(CMPPL,		CMPPL(Rn))						\
+	OP(LDSMMACL,	LDSMMACL(Rn))					\
+	OP(LDCMGBR,		LDCMGBR(Rn))					\
+	OP(SHLL8,		SHLL8(Rn))						\
+	OP(SHLR8,		SHLR8(Rn))						\
+	OP(LDSMACL,		LDSMACL(Rn))					\
+	OP(TAS,			TAS(Rn))						\
+	OP(LDCGBR,		LDCGBR(Rn))						\
+	OP(SHAL,		SHAL(Rn))						\
+	OP(SHAR,		SHAR(Rn))						\
+	OP(STSMPR,		STSMPR(Rn))						\
+	OP(STCMVBR,		STCMVBR(Rn))					\
+	OP(ROTCL,		ROTCL(Rn))						\
+	OP(ROTCR,		ROTCR(Rn))						\
+	OP(LDSMPR,		LDSMPR(Rn))						\
+	OP(LDCMVBR,		LDCMVBR(Rn))					\
+	OP(SHLL16,		SHLL16(Rn))						\
+	OP(SHLR16,		SHLR16(Rn))						\
+	OP(LDSPR,		LDSPR(Rn))						\
+	OP(JMP,			JMP(Rn))						\
+	OP(LDCVBR,		LDCVBR(Rn))						\
+	OP(MOVLL4,		MOVLL4(Rm, IMM4, Rn))		\
+	OP(MOVBL,		MOVBL(Rm, Rn))					\
+	OP(MOVWL,		MOVWL(Rm, Rn))					\
+	OP(MOVLL,		MOVLL(Rm, Rn))					\
+	OP(MOV,			MOV(Rm, Rn))					\
+	OP(MOVBP,		MOVBP(Rm, Rn))					\
+	OP(MOVWP,		MOVWP(Rm, Rn))					\
+	OP(MOVLP,		MOVLP(Rm, Rn))					\
+	OP(NOT,			NOT(Rm, Rn))					\
+	OP(SWAPB,		SWAPB(Rm, Rn))					\
+	OP(SWAPW,		SWAPW(Rm, Rn))					\
+	OP(NEGC,		NEGC(Rm, Rn))					\
+	OP(NEG,			NEG(Rm, Rn))					\
+	OP(EXTUB,		EXTUB(Rm, Rn))					\
+	OP(EXTUW,		EXTUW(Rm, Rn))					\
+	OP(EXTSB,		EXTSB(Rm, Rn))					\
+	OP(EXTSW,		EXTSW(Rm, Rn))					\
+	OP(ADDI,		ADDI(IMM8, Rn))				\
+	OP(MOVBS4,		MOVBS4(IMM4, Rm))			\
+	OP(MOVWS4,		MOVWS4(IMM4, Rm))			\
+	OP(MOVBL4,		MOVBL4(Rm, IMM4))			\
+	OP(MOVWL4,		MOVWL4(Rm, IMM4))			\
+	OP(CMPIM,		CMPIM(IMM8))				\
+	OP(BT,			BT(IMM8))					\
+	OP(BF,			BF(IMM8))					\
+	OP(BTS,			BTS(IMM8))					\
+	OP(BFS,			BFS(IMM8))					\
+	OP(MOVWI,		MOVWI(IMM8, Rn))			\
+	OP(BRA,			BRA(IMM12))					\
+	OP(BSR,			BSR(IMM12))					\
+	OP(MOVBSG,		MOVBSG(IMM8))				\
+	OP(MOVWSG,		MOVWSG(IMM8))				\
+	OP(MOVLSG,		MOVLSG(IMM8))				\
+	OP(TRAPA,		TRAPA(IMM8))				\
+	OP(MOVBLG,		MOVBLG(IMM8))				\
+	OP(MOVWLG,		MOVWLG(IMM8))				\
+	OP(MOVLLG,		MOVLLG(IMM8))				\
+	OP(MOVA,		MOVA(IMM8))					\
+	OP(TSTI,		TSTI(IMM8))					\
+	OP(ANDI,		ANDI(IMM8))					\
+	OP(XORI,		XORI(IMM8))					\
+	OP(ORI,			ORI(IMM8))					\
+	OP(TSTM,		TSTM(IMM8))					\
+	OP(ANDM,		ANDM(IMM8))					\
+	OP(XORM,		XORM(IMM8))					\
+	OP(ORM,			ORM(IMM8))					\
+	OP(MOVLI,		MOVLI(IMM8, Rn))			\
+	OP(MOVI,		MOVI(IMM8, Rn))
 
-	if(divider)
-		sh2->frc += (cur_time - sh2->frc_base) >> divider;
-	sh2->frc_base = cur_time;
-}
+enum {
+#define SH2_LEAF_ENUM(name, call)	SH2_LEAF_##name,
+	SH2_LEAF_LIST(SH2_LEAF_ENUM)
+#undef SH2_LEAF_ENUM
+	SH2_LEAF_COUNT
+};
 
-static void sh2_timer_activate(void)
-{
-	int max_delta = 0xfffff;
-	UINT16 frc;
+#define SH2_LEAF_FUNC(name, call)	static void sh2_leaf_##name(UINT16 opcode) { (void)opcode; call; }
+SH2_LEAF_LIST(SH2_LEAF_FUNC)
+#undef SH2_LEAF_FUNC
 
-	//timer_adjust(sh2->timer, attotime_never, 0, attotime_zero);
-	sh2->timer_active = 0;
-//	sh2->timer_cycles = 0;
+static void (* const sh2_leaf[SH2_LEAF_COUNT])(UINT16 opcode) = {
+#define SH2_LEAF_PTR(name, call)	sh2_leaf_##name,
+	SH2_LEAF_LIST(SH2_LEAF_PTR)
+#undef SH2_LEAF_PTR
+};
 
-	frc = sh2->frc;
-	if(!(sh2->m[4] & OCFA)) {
-		UINT16 delta = sh2->ocra - frc;
-		if(delta < max_delta)
-			max_delta = delta;
-	}
+#if USE_BLOCK_CACHE
+
+// the same leaves reading the operands sh2_block_build decoded into the uop
+#undef Rn
+#undef Rm
+#undef IMM4
+#undef IMM8
+#undef IMM12
+#define Rn		(op->n)
+#define Rm		(op->m)
+#define IMM4	(op->imm)
+#define IMM8	(op->imm)
+#define IMM12	(op->imm)
+
+#define SH2_LEAF_UOP(name, call)	static void sh2_uop_##name(const SH2UOP * op) { call; }
+SH2_LEAF_LIST(SH2_LEAF_UOP)
+#undef SH2_LEAF_UOP
+
+static void (* const sh2_uop_leaf[SH2_LEAF_COUNT])(const SH2UOP * op) = {
+#define SH2_LEAF_PTR(name, call)	sh2_uop_##name,
+	SH2_LEAF_LIST(SH2_LEAF_PTR)
+#undef SH2_LEAF_PTR
+};
 
-	if(!(sh2->m[4] & OCFB) && (sh2->ocra <= sh2->ocrb || !(sh2->m[4] & 0x010000))) {
-		UINT16 delta = sh2->ocrb - frc;
-		if(delta < max_delta)
-			max_delta = delta;
-	}
+#undef Rn
+#undef Rm
+#undef IMM4
+#undef IMM8
+#undef IMM12
+#define Rn		((opcode>>8)&15)
+#define Rm		((opcode>>4)&15)
+#define IMM4	(opcode & 0x0f)
+#define IMM8	(opcode & 0xff)
+#define IMM12	(opcode & 0xfff)
 
-	if(!(sh2->m[4] & OVF) && !(sh2->m[4] & 0x010000)) {
-		int delta = 0x10000 - frc;
-		if(delta < max_delta)
-			max_delta = delta;
-	}
+#endif
 
-	if(max_delta != 0xfffff) {
-		int divider = div_tab[(sh2->m[5] >> 8) & 3];
-		if(divider)
+#define L(name)		SH2_LEAF_##name
+
+static const UINT8 sh2_leaf_0000[64] = {
+	L(NOP),    L(NOP),    L(STCSR),   L(BSRF),   L(MOVBS0), L(MOVWS0), L(MOVLS0), L(MULL),
+	L(CLRT),   L(NOP),    L(STSMACH), L(RTS),    L(MOVBL0), L(MOVWL0), L(MOVLL0), L(MAC_L),
+	L(NOP),    L(NOP),    L(STCGBR),  L(NOP),    L(MOVBS0), L(MOVWS0), L(MOVLS0), L(MULL),
+	L(SETT),   L(DIV0U),  L(STSMACL), L(SLEEP),  L(MOVBL0), L(MOVWL0), L(MOVLL0), L(MAC_L),
+	L(NOP),    L(NOP),    L(STCVBR),  L(BRAF),   L(MOVBS0), L(MOVWS0), L(MOVLS0), L(MULL),
+	L(CLRMAC), L(MOVT),   L(STSPR),   L(RTE),    L(MOVBL0), L(MOVWL0), L(MOVLL0), L(MAC_L),
+	L(NOP),    L(NOP),    L(NOP),     L(NOP),    L(MOVBS0), L(MOVWS0), L(MOVLS0), L(MULL),
+	L(NOP),    L(NOP),    L(NOP),     L(NOP),    L(MOVBL0), L(MOVWL0), L(MOVLL0), L(MAC_L)
+};
+
+static const UINT8 sh2_leaf_0010[16] = {
+	L(MOVBS),  L(MOVWS),  L(MOVLS),   L(NOP),    L(MOVBM),  L(MOVWM),  L(MOVLM),  L(DIV0S),
+	L(TST),    L(AND),    L(XOR),     L(OR),     L(CMPSTR), L(XTRCT),  L(MULU),   L(MULS)
+};
+
+static const UINT8 sh2_leaf_0011[16] = {
+	L(CMPEQ),  L(NOP),    L(CMPHS),   L(CMPGE),  L(DIV1),   L(DMULU),  L(CMPHI),  L(CMPGT),
+	L(SUB),    L(NOP),    L(SUBC),    L(SUBV),   L(ADD),    L(DMULS),  L(ADDC),   L(ADDV)
+};
+
+static const UINT8 sh2_leaf_0100[64] = {
+	L(SHLL),   L(SHLR),   L(STSMMACH), L(STCMSR),  L(ROTL),   L(ROTR),   L(LDSMMACH), L(LDCMSR),
+	L(SHLL2),  L(SHLR2),  L(LDSMACH),  L(JSR),     L(NOP),    L(NOP),    L(LDCSR),    L(MAC_W),
+	L(DT),     L(CMPPZ),  L(STSMMACL), L(STCMGBR), L(NOP),    L(CMPPL),  L(LDSMMACL), L(LDCMGBR),
+	L(SHLL8),  L(SHLR8),  L(LDSMACL),  L(TAS),     L(NOP),    L(NOP),    L(LDCGBR),   L(MAC_W),
+	L(SHAL),   L(SHAR),   L(STSMPR),   L(STCMVBR), L(ROTCL),  L(ROTCR),  L(LDSMPR),   L(LDCMVBR),
+	L(SHLL16), L(SHLR16), L(LDSPR),    L(JMP),     L(NOP),    L(NOP),    L(LDCVBR),   L(MAC_W),
+	L(NOP),    L(NOP),    L(NOP),      L(NOP),     L(NOP),    L(NOP),    L(NOP),      L(NOP),
+	L(NOP),    L(NOP),    L(NOP),      L(NOP),     L(NOP),    L(NOP),    L(NOP),      L(MAC_W)
+};
+
+static const UINT8 sh2_leaf_0110[16] = {
+	L(MOVBL),  L(MOVWL),  L(MOVLL),   L(MOV),    L(MOVBP),  L(MOVWP),  L(MOVLP),  L(NOT),
+	L(SWAPB),  L(SWAPW),  L(NEGC),    L(NEG),    L(EXTUB),  L(EXTUW),  L(EXTSB),  L(EXTSW)
+};
+
+static const UINT8 sh2_leaf_1000[16] = {
+	L(MOVBS4), L(MOVWS4), L(NOP),     L(NOP),    L(MOVBL4), L(MOVWL4), L(NOP),    L(NOP),
+	L(CMPIM),  L(BT),     L(NOP),     L(BF),     L(NOP),    L(BTS),    L(NOP),    L(BFS)
+};
+
+static const UINT8 sh2_leaf_1100[16] = {
+	L(MOVBSG), L(MOVWSG), L(MOVLSG),  L(TRAPA),  L(MOVBLG), L(MOVWLG), L(MOVLLG), L(MOVA),
+	L(TSTI),   L(ANDI),   L(XORI),    L(ORI),    L(TSTM),   L(ANDM),   L(XORM),   L(ORM)
+};
+
+static const UINT8 sh2_leaf_group[16] = {
+	0,         L(MOVLS4), 0,          0,         0,         L(MOVLL4), 0,         L(ADDI),
+	0,         L(MOVWI),  L(BRA),     L(BSR),    0,         L(MOVLI),  L(MOVI),   L(NOP)
+};
+
+#undef L
+
+static UINT8 sh2_leaf_index[0x10000];
+
+static void sh2_leaf_init(void)
+{
+	for (int i = 0; i < 0x10000; i++) {
+		switch (i >> 12)
 		{
-			max_delta <<= divider;
-			sh2->frc_base = sh2_GetTotalCycles();
-			sh2->timer_active = 1;
-			sh2->timer_cycles = max_delta;
-			sh2->timer_base = sh2->frc_base;
-			
+		case  0: sh2_leaf_index[i] = sh2_leaf_0000[i & 0x3f];			break;
+		case  2: sh2_leaf_index[i] = sh2_leaf_0010[i & 15];				break;
+		case  3: sh2_leaf_index[i] = sh2_leaf_0011[i & 15];				break;
+		case  4: sh2_leaf_index[i] = sh2_leaf_0100[i & 0x3f];			break;
+		case  6: sh2_leaf_index[i] = sh2_leaf_0110[i & 15];				break;
+		case  8: sh2_leaf_index[i] = sh2_leaf_1000[(i >> 8) & 15];		break;
+		case 12: sh2_leaf_index[i] = sh2_leaf_1100[(i >> 8) & 15];		break;
+		default: sh2_leaf_index[i] = sh2_leaf_group[i >> 12];			break;
 		}
 	}
 }
 
-static void sh2_recalc_irq(void)
-{
-	int irq = 0, vector = -1;
-	int  level;
+#define SH2_HANDLER(opcode)		sh2_leaf[sh2_leaf_index[opcode]]
+#define SH2_UOP_HANDLER(opcode)	sh2_uop_leaf[sh2_leaf_index[opcode]]
 
-	// Timer irqs
-	if((sh2->m[4]>>8) & sh2->m[4] & (ICF|OCFA|OCFB|OVF))
-	{
+#else
+
+static void (* const sh2_opgroup[16])(UINT16 opcode) = {
+	op0000, op0001, op0010, op0011, op0100, op0101, op0110, op0111,
+	op1000, op1001, op1010, op1011, op1100, op1101, op1110, op1111
+};
+
+#define SH2_HANDLER(opcode)		sh2_opgroup[(opcode) >> 12]
+
+#if USE_BLOCK_CACHE
+static void sh2_uop_group(const SH2UOP * op)
+{
+	sh2_opgroup[op->opcode >> 12](op->opcode);
+}
+
+#define SH2_UOP_HANDLER(opcode)	sh2_uop_group
+#endif
+
+#endif	// USE_JUMPTABLE
+
+#if USE_BLOCK_CACHE
+
+enum { SH2_OP_NORMAL = 0, SH2_OP_END, SH2_OP_DELAYED };
+
+// how an opcode affects the flow of a block
+static int sh2_op_flow(UINT16 opcode)
+{
+	switch (opcode >> 12)
+	{
+	case  0:
+		switch (opcode & 0x3f) {
+		case 0x03: case 0x0b: case 0x23: case 0x2b: return SH2_OP_DELAYED;	// BSRF, RTS, BRAF, RTE
+		case 0x1b: return SH2_OP_END;											// SLEEP
+		}
+		break;
+	case  4:
+		switch (opcode & 0x3f) {
+		case 0x0b: case 0x2b: return SH2_OP_DELAYED;							// JSR, JMP
+		}
+		break;
+	case  8:
+		switch ((opcode >> 8) & 15) {
+		case  9: case 11: return SH2_OP_END;									// BT, BF
+		case 13: case 15: return SH2_OP_DELAYED;								// BT/S, BF/S
+		}
+		break;
+	case 10:
+	case 11: return SH2_OP_DELAYED;												// BRA, BSR
+	case 12:
+		if (((opcode >> 8) & 15) == 3) return SH2_OP_END;						// TRAPA
+		break;
+	}
+	return SH2_OP_NORMAL;
+}
+
+#if IDLE_LOOP_SKIP || COPY_LOOP_SKIP
+
+// the branch ending the block goes back to its first op
+static int sh2_block_loops(UINT32 pc, SH2UOP * op, int count, int flags)
+{
+	int b = count - ((flags & SH2_BLOCK_DELAY) ? 2 : 1);
+	UINT16 br = op[b].opcode;
+	UINT32 target = pc + b * 2 + 4;
+
+	if ((br & 0xf900) == 0x8900)												// BT, BF, BT/S, BF/S
+		target += (INT32)(INT8)(br & 0xff) * 2;
+	else if ((br & 0xf000) == 0xa000)											// BRA
+		target += ((INT32)((br & 0xfff) << 20)) >> 19;
+	else
+		return 0;
+
+	return target == pc;
+}
+
+#endif
+
+#if IDLE_LOOP_SKIP
+
+// A block that branches back to its own start, never stores and carries
+// no register over from one pass to the next does the same thing on every
+// pass until something else changes the memory it reads: a poll loop.
+// Register masks hold R0-R15 in bits 0-15, then GBR and T.
+
+#define SH2_IDLE_GBR		(1 << 16)
+#define SH2_IDLE_T			(1 << 17)
+
+#define SH2_IDLE_REJECT		(-1)
+#define SH2_IDLE_ALU		(0)
+#define SH2_IDLE_LOAD		(1)
+
+static int sh2_idle_op(UINT16 opcode, UINT32 * rd, UINT32 * wr)
+{
+	UINT32 n = 1 << ((opcode >> 8) & 15);
+	UINT32 m = 1 << ((opcode >> 4) & 15);
+
+	switch (opcode >> 12) {
+	case  0:
+		if (opcode == 0x0009) {													// NOP
+			*rd = 0; *wr = 0; return SH2_IDLE_ALU;
+		}
+		if ((opcode & 0xff) == 0x29) {											// MOVT
+			*rd = SH2_IDLE_T; *wr = n; return SH2_IDLE_ALU;
+		}
+		switch (opcode & 15) {
+		case 12: case 13: case 14:												// MOV.x @(R0,Rm),Rn
+			*rd = m | 1; *wr = n; return SH2_IDLE_LOAD;
+		}
+		break;
+	case  2:
+		switch (opcode & 15) {
+		case  8: case 12:														// TST, CMP/STR
+			*rd = m | n; *wr = SH2_IDLE_T; return SH2_IDLE_ALU;
+		case  9: case 10: case 11:												// AND, XOR, OR
+			*rd = m | n; *wr = n; return SH2_IDLE_ALU;
+		}
+		break;
+	case  3:
+		switch (opcode & 15) {
+		case  0: case  2: case  3: case  6: case  7:							// CMP/EQ, HS, GE, HI, GT
+			*rd = m | n; *wr = SH2_IDLE_T; return SH2_IDLE_ALU;
+		case  8: case 12:														// SUB, ADD
+			*rd = m | n; *wr = n; return SH2_IDLE_ALU;
+		}
+		break;
+	case  4:
+		switch (opcode & 0xff) {
+		case 0x00: case 0x01: case 0x04: case 0x05: case 0x20: case 0x21:		// SHLL, SHLR, ROTL, ROTR, SHAL, SHAR
+			*rd = n; *wr = n | SH2_IDLE_T; return SH2_IDLE_ALU;
+		case 0x08: case 0x09: case 0x18: case 0x19: case 0x28: case 0x29:		// SHLLn, SHLRn
+			*rd = n; *wr = n; return SH2_IDLE_ALU;
+		case 0x11: case 0x15:													// CMP/PZ, CMP/PL
+			*rd = n; *wr = SH2_IDLE_T; return SH2_IDLE_ALU;
+		}
+		break;
+	case  5:																	// MOV.L @(disp,Rm),Rn
+		*rd = m; *wr = n; return SH2_IDLE_LOAD;
+	case  6:
+		switch (opcode & 15) {
+		case  0: case  1: case  2:												// MOV.x @Rm,Rn
+			*rd = m; *wr = n; return SH2_IDLE_LOAD;
+		case  3: case  7: case  8: case  9: case 11:							// MOV, NOT, SWAP.x, NEG
+		case 12: case 13: case 14: case 15:										// EXTU.x, EXTS.x
+			*rd = m; *wr = n; return SH2_IDLE_ALU;
+		}
+		break;
+	case  7:																	// ADD #imm,Rn
+		*rd = n; *wr = n; return SH2_IDLE_ALU;
+	case  8:
+		switch ((opcode >> 8) & 15) {
+		case  4: case  5:														// MOV.x @(disp,Rm),R0
+			*rd = m; *wr = 1; return SH2_IDLE_LOAD;
+		case  8:																// CMP/EQ #imm,R0
+			*rd = 1; *wr = SH2_IDLE_T; return SH2_IDLE_ALU;
+		case  9: case 11: case 13: case 15:										// BT, BF, BT/S, BF/S
+			*rd = SH2_IDLE_T; *wr = 0; return SH2_IDLE_ALU;
+		}
+		break;
+	case  9: case 13:															// MOV.x @(disp,PC),Rn
+		*rd = 0; *wr = n; return SH2_IDLE_LOAD;
+	case 10:																	// BRA
+		*rd = 0; *wr = 0; return SH2_IDLE_ALU;
+	case 12:
+		switch ((opcode >> 8) & 15) {
+		case  4: case  5: case  6:												// MOV.x @(disp,GBR),R0
+			*rd = SH2_IDLE_GBR; *wr = 1; return SH2_IDLE_LOAD;
+		case  8:																// TST #imm,R0
+			*rd = 1; *wr = SH2_IDLE_T; return SH2_IDLE_ALU;
+		case  9: case 10: case 11:												// AND, XOR, OR #imm,R0
+			*rd = 1; *wr = 1; return SH2_IDLE_ALU;
+		case 12:																// TST.B #imm,@(R0,GBR)
+			*rd = 1 | SH2_IDLE_GBR; *wr = SH2_IDLE_T; return SH2_IDLE_LOAD;
+		}
+		break;
+	case 14:																	// MOV #imm,Rn
+		*rd = 0; *wr = n; return SH2_IDLE_ALU;
+	}
+	return SH2_IDLE_REJECT;
+}
+
+// address of a load accepted by sh2_idle_op, pc is the address of the op
+static UINT32 sh2_idle_ea(UINT16 opcode, UINT32 pc)
+{
+	UINT32 m = (opcode >> 4) & 15;
+
+	switch (opcode >> 12) {
+	case  0: return sh2->r[0] + sh2->r[m];
+	case  5: return sh2->r[m] + ((opcode & 15) << 2);
+	case  6: return sh2->r[m];
+	case  8: return sh2->r[m] + ((opcode & 15) << ((opcode >> 8) & 1));
+	case  9: return pc + 4 + ((opcode & 0xff) << 1);
+	case 12:
+		if (((opcode >> 8) & 15) == 12)
+			return sh2->gbr + sh2->r[0];
+		return sh2->gbr + ((opcode & 0xff) << ((opcode >> 8) & 3));
+	}
+	return ((pc + 4) & ~3) + ((opcode & 0xff) << 2);
+}
+
+static int sh2_idle_block(UINT32 pc, SH2UOP * op, int count, int flags)
+{
+	if (!sh2_block_loops(pc, op, count, flags))
+		return 0;
+
+	UINT32 rd, wr, written = 0, base = 0;
+
+	for (int i = 0; i < count; i++) {
+		int kind = sh2_idle_op(op[i].opcode, &rd, &wr);
+		if (kind == SH2_IDLE_REJECT)
+			return 0;
+		if (kind == SH2_IDLE_LOAD)
+			base |= rd;
+		written |= wr;
+	}
+
+	// load addresses have to stay put for the whole pass
+	if (base & written)
+		return 0;
+
+	// and nothing may be read before this pass wrote it
+	UINT32 done = 0;
+	for (int i = 0; i < count; i++) {
+		sh2_idle_op(op[i].opcode, &rd, &wr);
+		if (rd & written & ~done)
+			return 0;
+		done |= wr;
+	}
+
+	return 1;
+}
+
+// an idle block just branched back to itself, nothing it reads can change
+// until an irq or a timer event unless it reads through a handler
+static void sh2_idle_skip(SH2BLOCK * blk)
+{
+	SH2UOP * op = pSh2Ext->cache.uop + blk->uop;
+	UINT32 rd, wr;
+
+	for (int i = 0; i < blk->count; i++) {
+		if (sh2_idle_op(op[i].opcode, &rd, &wr) != SH2_IDLE_LOAD)
+			continue;
+		UINT32 A = sh2_idle_ea(op[i].opcode, blk->pc + i * 2);
+		if ((uintptr_t)SH2_MAP(SH2_MAP_READ, A) < SH2_MAXHANDLER) {
+			blk->flags &= ~SH2_BLOCK_IDLE;
+			return;
+		}
+	}
+
+	if (!(blk->flags & SH2_BLOCK_IDLE_SEEN)) {
+		blk->flags |= SH2_BLOCK_IDLE_SEEN;
+		bprintf(PRINT_NORMAL, "SH2 idle loop at %08x%s\n", blk->pc, (blk->flags & SH2_BLOCK_HINT) ? ", as the driver expects" : "");
+	}
+
+	if (sh2->timer_active || sh2->dma_timer_active[0] || sh2->dma_timer_active[1]) {
+		// run up to the next deadline, the event may well end the loop
+		sh2->sh2_total_cycles += sh2->sh2_icount;
+		sh2->sh2_icount = 0;
+	} else
+		Sh2BurnUntilInt(0);
+}
+
+// the driver's poll loop ran a pass the detector did not take for one,
+// burn to the next irq the way the old per-game read handlers did
+static void sh2_hint_skip(SH2BLOCK * blk)
+{
+	if (!(blk->flags & SH2_BLOCK_HINT_SEEN)) {
+		blk->flags |= SH2_BLOCK_HINT_SEEN;
+		bprintf(PRINT_ERROR, "SH2 idle loop expected at %08x polling %08x not detected\n", pSh2Ext->cache.hint_pc, pSh2Ext->cache.hint_address);
+	}
+
+	Sh2BurnUntilInt(0);
+}
+
+#endif
+
+#if COPY_LOOP_SKIP
+
+// A block that loads through one pointer, stores through another and
+// counts down with DT and BF (or BF/S) to its own start is a copy loop,
+// without the load it is a fill loop. Once it has branched back, the
+// passes left in a direct mapped page span are done natively in one go.
+
+#ifdef MSB_FIRST
+#define SH2_COPY_B(a)		(a)
+#define SH2_COPY_W(a)		(a)
+#else
+#define SH2_COPY_B(a)		((a) ^ 3)
+#define SH2_COPY_W(a)		((a) ^ 2)
+#endif
+
+typedef struct
+{
+	int		src;			// load pointer, -1 for a fill
+	int		dst;			// store pointer
+	int		cnt;			// DT counter
+	int		val;			// register stored
+	int		size;
+	INT32	lo, so;			// load and store offset from the pointers at the start of a pass
+	INT32	ds, dd;			// pointer steps per pass
+	int		ea;				// last op setting ea: 0 the branch, 1 the load, 2 the store
+	int		cost;			// cycles per pass with the branch taken
+} SH2COPY;
+
+static int sh2_copy_parse(SH2UOP * op, int count, int flags, SH2COPY * cp)
+{
+	int b = count - ((flags & SH2_BLOCK_DELAY) ? 2 : 1);
+	UINT16 br = op[b].opcode;
+	INT32 off[16];
+	UINT32 stepped = 0;
+	int load = -1, store = -1, dt = -1, lsize = 0, loaded = -1;
+
+	if ((br & 0xfb00) != 0x8b00)												// BF, BF/S
+		return 0;
+
+	memset(off, 0, sizeof(off));
+	cp->src = -1;
+	cp->ea = 0;
+	cp->cost = count + ((br & 0x0400) ? 1 : 2);
+
+	for (int i = 0; i < count; i++) {
+		UINT16 opcode = op[i].opcode;
+		int n = (opcode >> 8) & 15;
+		int m = (opcode >> 4) & 15;
+
+		if (i == b || opcode == 0x0009)											// the branch, NOP
+			continue;
+
+		switch (opcode >> 12) {
+		case  2:																// MOV.x Rm,@Rn / Rm,@-Rn
+			if ((opcode & 3) == 3 || (opcode & 8) || store >= 0)
+				return 0;
+			store = i;
+			cp->dst = n;
+			cp->val = m;
+			cp->size = 1 << (opcode & 3);
+			if (opcode & 4)
+				off[n] -= cp->size;
+			cp->so = off[n];
+			if (i > b)
+				cp->ea = (opcode & 4) ? 0 : 2;
+			break;
+		case  4:																// DT Rn
+			if ((opcode & 0xff) != 0x10 || dt >= 0)
+				return 0;
+			dt = i;
+			cp->cnt = n;
+			break;
+		case  6:																// MOV.x @Rm,Rn / @Rm+,Rn
+			if ((opcode & 3) == 3 || (opcode & 8) || load >= 0 || n == m)
+				return 0;
+			load = i;
+			cp->src = m;
+			cp->lo = off[m];
+			lsize = 1 << (opcode & 3);
+			if (opcode & 4)
+				off[m] += lsize;
+			loaded = n;
+			if (i > b)
+				cp->ea = (opcode & 4) ? 0 : 1;
+			break;
+		case  7:																// ADD #imm,Rn
+			off[n] += (INT32)(INT8)(opcode & 0xff);
+			stepped |= 1 << n;
+			break;
+		default:
+			return 0;
+		}
+	}
+
+	if (store < 0 || dt < 0 || dt > b)
+		return 0;
+
+	// a copy stores what this pass loaded, a fill a register left alone
+	UINT32 ptr = 1 << cp->dst;
+	if (cp->src >= 0) {
+		if (load > store || lsize != cp->size || loaded != cp->val || cp->src == cp->dst)
+			return 0;
+		ptr |= 1 << cp->src;
+	}
+
+	// only the pointers are stepped and the counter is nothing else
+	if ((stepped & ~ptr) || (ptr & (1 << cp->val)) || ((ptr | (1 << cp->val)) & (1 << cp->cnt)))
+		return 0;
+
+	cp->ds = (cp->src >= 0) ? off[cp->src] : 0;
+	cp->dd = off[cp->dst];
+
+	if (cp->dd != cp->size && cp->dd != -cp->size)
+		return 0;
+	if (cp->src >= 0 && cp->ds != cp->size && cp->ds != -cp->size)
+		return 0;
+
+	return 1;
+}
+
+static int sh2_copy_block(UINT32 pc, SH2UOP * op, int count, int flags)
+{
+	SH2COPY cp;
+
+	if (!sh2_block_loops(pc, op, count, flags))
+		return 0;
+
+	return sh2_copy_parse(op, count, flags, &cp);
+}
+
+// passes whose accesses all fall in the page of the first one
+static UINT32 sh2_copy_span(UINT32 A, INT32 step, int size)
+{
+	if (step > 0)
+		return (SH2_PAGE_SIZE - (A & SH2_PAGEM)) / size;
+	return (A & SH2_PAGEM) / size + 1;
+}
+
+// a copy or fill block just branched back to itself, run every pass that
+// would branch back again, fits in the slice and stays in the same direct
+// mapped pages, leaving registers, T, ea and the cycle counts as the
+// interpreter would have
+static void sh2_copy_skip(SH2BLOCK * blk)
+{
+	SH2UOP * op = pSh2Ext->cache.uop + blk->uop;
+	SH2COPY cp;
+
+	sh2_copy_parse(op, blk->count, blk->flags, &cp);
+
+	// the last pass falls through the branch, it is left to the interpreter
+	UINT32 n = sh2->r[cp.cnt] - 1;
+	UINT32 fit = (UINT32)(sh2->sh2_icount - 1) / cp.cost;
+	if (n > fit)
+		n = fit;
+
+	UINT32 d = sh2->r[cp.dst] + cp.so;
+	UINT32 s = (cp.src >= 0) ? sh2->r[cp.src] + cp.lo : 0;
+	unsigned char * pd = SH2_MAP(SH2_MAP_WRITE, d);
+	unsigned char * ps = (cp.src >= 0) ? SH2_MAP(SH2_MAP_READ, s) : NULL;
+
+	// these hold for the rest of the page at least, stop looking until the loop is left
+	if ((uintptr_t)pd < SH2_MAXHANDLER || ((d | s) & (cp.size - 1)) || (cp.src >= 0 && (uintptr_t)ps < SH2_MAXHANDLER)) {
+		blk->flags = (blk->flags & ~SH2_BLOCK_COPY) | SH2_BLOCK_COPY_HELD;
+		return;
+	}
+
+	UINT32 span = sh2_copy_span(d, cp.dd, cp.size);
+	if (n > span)
+		n = span;
+	if (cp.src >= 0) {
+		span = sh2_copy_span(s, cp.ds, cp.size);
+		if (n > span)
+			n = span;
+	}
+	if (n == 0)
+		return;
+
+	UINT32 v = sh2->r[cp.val];
+	UINT32 s0 = s, d0 = d;
+
+	if (cp.src >= 0 && cp.size == 4 && cp.ds == 4 && cp.dd == 4 &&
+		!(pd + (d & SH2_PAGEM) > ps + (s & SH2_PAGEM) && pd + (d & SH2_PAGEM) < ps + (s & SH2_PAGEM) + n * 4)) {
+		// nothing stored is loaded again later on
+		v = *(UINT32 *)(ps + ((s + (n - 1) * 4) & SH2_PAGEM));
+		memmove(pd + (d & SH2_PAGEM), ps + (s & SH2_PAGEM), n * 4);
+	} else {
+		switch (cp.size) {
+		case 1:
+			for (UINT32 i = 0; i < n; i++, s += cp.ds, d += cp.dd) {
+				if (cp.src >= 0)
+					v = (UINT32)(INT32)(INT8)ps[SH2_COPY_B(s) & SH2_PAGEM];
+				pd[SH2_COPY_B(d) & SH2_PAGEM] = (UINT8)v;
+			}
+			break;
+		case 2:
+			for (UINT32 i = 0; i < n; i++, s += cp.ds, d += cp.dd) {
+				if (cp.src >= 0)
+					v = (UINT32)(INT32)*(INT16 *)(ps + (SH2_COPY_W(s) & SH2_PAGEM));
+				*(UINT16 *)(pd + (SH2_COPY_W(d) & SH2_PAGEM)) = (UINT16)v;
+			}
+			break;
+		case 4:
+			for (UINT32 i = 0; i < n; i++, s += cp.ds, d += cp.dd) {
+				if (cp.src >= 0)
+					v = *(UINT32 *)(ps + (s & SH2_PAGEM));
+				*(UINT32 *)(pd + (d & SH2_PAGEM)) = v;
+			}
+			break;
+		}
+	}
+
+	sh2->r[cp.dst] += n * cp.dd;
+	if (cp.src >= 0) {
+		sh2->r[cp.src] += n * cp.ds;
+		sh2->r[cp.val] = v;
+	}
+	sh2->r[cp.cnt] -= n;
+	sh2->sr &= ~T;
+
+	switch (cp.ea) {
+	case 0: sh2->ea = blk->pc; break;
+	case 1: sh2->ea = s0 + (n - 1) * cp.ds; break;
+	case 2: sh2->ea = d0 + (n - 1) * cp.dd; break;
+	}
+
+	sh2->sh2_total_cycles += n * blk->count;
+	sh2->sh2_icount -= n * cp.cost;
+}
+
+#endif
+
+// the immediate field the leaf of each opcode takes
+static UINT16 sh2_op_imm(UINT16 opcode)
+{
+	switch (opcode >> 12) {
+	case  1: case  5: return opcode & 0x0f;								// MOV.L @(disp,Rn)
+	case  7: case  9: case 12: case 13: case 14: return opcode & 0xff;
+	case  8:
+		if (!(opcode & 0x0800)) return opcode & 0x0f;					// MOV.B/W @(disp,Rn)
+		return opcode & 0xff;
+	case 10: case 11: return opcode & 0xfff;							// BRA, BSR
+	}
+	return 0;
+}
+
+static void sh2_uop_decode(SH2UOP * op, UINT16 opcode)
+{
+	op->handler = SH2_UOP_HANDLER(opcode);
+	op->opcode = opcode;
+	op->n = (opcode >> 8) & 15;
+	op->m = (opcode >> 4) & 15;
+	op->imm = sh2_op_imm(opcode);
+}
+
+static SH2BLOCK * sh2_block_build(UINT32 pc)
+{
+	SH2CACHE * c = &pSh2Ext->cache;
+	UINT32 A = pc & AM;
+	UINT32 page = A >> SH2_SHIFT;
+	unsigned char * pr = SH2_MAP(SH2_MAP_FETCH, A);
+
+	// only cache code the cpu cannot overwrite by itself
+	if ((pc & 1) || (uintptr_t)pr < SH2_MAXHANDLER || pr == SH2_MAP(SH2_MAP_WRITE, A))
+		return NULL;
+
+	if (c->uop_used + SH2_BLOCK_OPS > SH2_UOP_COUNT)
+		sh2_cache_flush();
+
+	SH2UOP * op = c->uop + c->uop_used;
+	UINT32 end = (A | (SH2_LINE_SIZE - 1)) + 1;
+	int count = 0, flags = 0;
+
+	while (A < end && count < SH2_BLOCK_OPS) {
+#ifdef MSB_FIRST
+		UINT16 opcode = *(UINT16 *)(pr + (A & SH2_PAGEM));
+#else
+		UINT16 opcode = *(UINT16 *)(pr + ((A & SH2_PAGEM) ^ 2));
+#endif
+		int flow = sh2_op_flow(opcode);
+
+		if (flow == SH2_OP_DELAYED) {
+			// branch and its delay slot stay together
+			if (A + 2 >= end || count + 2 > SH2_BLOCK_OPS)
+				break;
+			sh2_uop_decode(op + count++, opcode);
+#ifdef MSB_FIRST
+			opcode = *(UINT16 *)(pr + ((A + 2) & SH2_PAGEM));
+#else
+			opcode = *(UINT16 *)(pr + (((A + 2) & SH2_PAGEM) ^ 2));
+#endif
+			sh2_uop_decode(op + count++, opcode);
+			flags = SH2_BLOCK_DELAY;
+			break;
+		}
+
+		sh2_uop_decode(op + count++, opcode);
+		A += 2;
+
+		if (flow == SH2_OP_END)
+			break;
+	}
+
+	if (count == 0)
+		return NULL;
+
+	SH2BLOCK * blk = c->block + ((pc >> 1) & (SH2_BLOCK_COUNT - 1));
+	blk->pc = pc;
+	blk->gen = c->line_gen[SH2_LINE(pc & AM)];
+	blk->uop = c->uop_used;
+	blk->count = count;
+	blk->flags = flags;
+#if IDLE_LOOP_SKIP
+	if (sh2_idle_block(pc, op, count, flags))
+		blk->flags |= SH2_BLOCK_IDLE;
+	if (c->hint_pc >= (pc & AM) && c->hint_pc < (pc & AM) + count * 2)
+		blk->flags |= SH2_BLOCK_HINT;
+#endif
+#if USE_SH2_DRC
+	blk->hits = 0;
+	blk->code = NULL;
+#endif
+
+	// the pc seen by a handler is up to one op past the block
+	for (int i = 0; i < SH2_MAXWATCH; i++)
+		if (c->watch_cb[i] && c->watch_pc[i] >= (pc & AM) && c->watch_pc[i] <= (pc & AM) + count * 2)
+			blk->flags |= SH2_BLOCK_WATCH;
+#if COPY_LOOP_SKIP
+	// a watched pc has to be seen on every pass
+	if (!(blk->flags & SH2_BLOCK_WATCH) && sh2_copy_block(pc, op, count, flags))
+		blk->flags |= SH2_BLOCK_COPY;
+#endif
+
+	c->uop_used += count;
+	c->page_code[page] = 1;
+
+	return blk;
+}
+
+static void sh2_watch_hit(SH2BLOCK * blk)
+{
+	SH2CACHE * c = &pSh2Ext->cache;
+	UINT32 A = blk->pc & AM;
+
+	for (int i = 0; i < SH2_MAXWATCH; i++)
+		if (c->watch_cb[i] && c->watch_pc[i] >= A && c->watch_pc[i] <= A + blk->count * 2)
+			c->watch_cb[i](c->watch_pc[i]);
+}
+
+// runs the branch ending a block and its delay slot, pc and ppc already
+// point past the branch
+static void sh2_block_branch(SH2UOP * op)
+{
+	op->handler(op);
+	sh2->sh2_total_cycles++;
+	sh2->sh2_icount--;
+
+	if (sh2->sh2_icount <= 0 || pSh2Ext->suspend)
+		return;
+
+	if (sh2->delay) {
+		change_pc(sh2->pc & AM);
+		sh2->delay = 0;
+	} else {
+		// branch not taken, the slot is an ordinary instruction
+		if (sh2->test_irq || sh2->pc != sh2->ppc)
+			return;
+		sh2->pc += 2;
+	}
+
+	op++;
+	sh2->ppc = sh2->pc;
+	op->handler(op);
+	sh2->sh2_total_cycles++;
+	sh2->sh2_icount--;
+}
+
+// runs a block, stopping early wherever the single step loop would have
+// to act (irq test, suspend, end of slice or an exception taken by a handler)
+SH2_INLINE void sh2_block_run(SH2BLOCK * blk)
+{
+	SH2UOP * op = pSh2Ext->cache.uop + blk->uop;
+	SH2UOP * end = op + blk->count;
+	UINT32 pc = sh2->pc;
+
+	if (blk->flags & SH2_BLOCK_DELAY)
+		end -= 2;
+
+	while (op != end) {
+		pc += 2;
+		sh2->pc = sh2->ppc = pc;
+		op->handler(op);
+		sh2->sh2_total_cycles++;
+		sh2->sh2_icount--;
+
+		if (++op == end && !(blk->flags & SH2_BLOCK_DELAY))
+			return;
+		if (sh2->sh2_icount <= 0 || sh2->test_irq || pSh2Ext->suspend || sh2->pc != pc)
+			return;
+	}
+
+	sh2->pc = sh2->ppc = pc + 2;
+	sh2_block_branch(op);
+}
+
+#if USE_SH2_DRC
+	#include "sh2drc.inc"
+#endif
+
+#endif
+
+/*****************************************************************************
+ *  MAME CPU INTERFACE
+ *****************************************************************************/
+
+// The free running timer and both dma channels post their deadlines by
+// calling sh2_event_schedule(). It splits what is left of the slice so
+// sh2_icount runs out on the nearest deadline and keeps the remainder in
+// sh2_icount_rest; Sh2Run only looks at the timers once sh2_icount is
+// used up, which is the same instruction polling after every op fired on.
+
+static void sh2_event_schedule(void)
+{
+	INT32 left = sh2->sh2_icount + sh2->sh2_icount_rest;
+	INT32 next = left;
+	UINT32 cy = sh2_GetTotalCycles();
+
+	if (sh2->dma_timer_active[0]) {
+		INT32 delta = sh2->dma_timer_cycles[0] - (cy - sh2->dma_timer_base[0]);
+		if (delta < next)
+			next = delta;
+	}
+
+	if (sh2->dma_timer_active[1]) {
+		INT32 delta = sh2->dma_timer_cycles[1] - (cy - sh2->dma_timer_base[1]);
+		if (delta < next)
+			next = delta;
+	}
+
+	if (sh2->timer_active) {
+		INT32 delta = sh2->timer_cycles - (cy - sh2->timer_base);
+		if (delta < next)
+			next = delta;
+	}
+
+	// a deadline already reached is taken after the next instruction
+	if (next < 1)
+		next = 1;
+
+	if (next < left) {
+		sh2->sh2_icount = next;
+		sh2->sh2_icount_rest = left - next;
+	} else {
+		sh2->sh2_icount = left;
+		sh2->sh2_icount_rest = 0;
+	}
+}
+
+static void sh2_timer_resync(void)
+{
+	int divider = div_tab[(sh2->m[5] >> 8) & 3];
+	UINT32 cur_time = sh2_GetTotalCycles();
+
+	if(divider)
+		sh2->frc += (cur_time - sh2->frc_base) >> divider;
+	sh2->frc_base = cur_time;
+}
+
+static void sh2_timer_activate(void)
+{
+	int max_delta = 0xfffff;
+	UINT16 frc;
+
+	//timer_adjust(sh2->timer, attotime_never, 0, attotime_zero);
+	sh2->timer_active = 0;
+//	sh2->timer_cycles = 0;
+
+	frc = sh2->frc;
+	if(!(sh2->m[4] & OCFA)) {
+		UINT16 delta = sh2->ocra - frc;
+		if(delta < max_delta)
+			max_delta = delta;
+	}
+
+	if(!(sh2->m[4] & OCFB) && (sh2->ocra <= sh2->ocrb || !(sh2->m[4] & 0x010000))) {
+		UINT16 delta = sh2->ocrb - frc;
+		if(delta < max_delta)
+			max_delta = delta;
+	}
+
+	if(!(sh2->m[4] & OVF) && !(sh2->m[4] & 0x010000)) {
+		int delta = 0x10000 - frc;
+		if(delta < max_delta)
+			max_delta = delta;
+	}
+
+	if(max_delta != 0xfffff) {
+		int divider = div_tab[(sh2->m[5] >> 8) & 3];
+		if(divider)
+		{
+			max_delta <<= divider;
+			sh2->frc_base = sh2_GetTotalCycles();
+			sh2->timer_active = 1;
+			sh2->timer_cycles = max_delta;
+			sh2->timer_base = sh2->frc_base;
+			sh2_event_schedule();
+		}
+	}
+}
+
+static void sh2_recalc_irq(void)
+{
+	int irq = 0, vector = -1;
+	int  level;
+
+	// Timer irqs
+	if((sh2->m[4]>>8) & sh2->m[4] & (ICF|OCFA|OCFB|OVF))
+	{
 		level = (sh2->m[0x18] >> 24) & 15;
 		if(level > irq)
 		{
@@ -2767,6 +4116,90 @@ static void sh2_dmac_callback(int dma)
 	sh2_recalc_irq();
 }
 
+static void sh2_event_check(void)
+{
+	sh2->sh2_icount += sh2->sh2_icount_rest;
+	sh2->sh2_icount_rest = 0;
+
+	UINT32 cy = sh2_GetTotalCycles();
+
+	if (sh2->dma_timer_active[0])
+		if ((cy - sh2->dma_timer_base[0]) >= sh2->dma_timer_cycles[0])
+			sh2_dmac_callback(0);
+
+	if (sh2->dma_timer_active[1])
+		if ((cy - sh2->dma_timer_base[1]) >= sh2->dma_timer_cycles[1])
+			sh2_dmac_callback(1);
+
+	if ( sh2->timer_active )
+		if ((cy - sh2->timer_base) >= sh2->timer_cycles)
+			sh2_timer_callback();
+
+	sh2_event_schedule();
+}
+
+// moves one transfer unit through the memory map
+static void sh2_dmac_unit(int size, UINT32 src, UINT32 dst)
+{
+	switch(size)
+	{
+	case 0:
+		WB(dst, RB(src));
+		break;
+	case 1:
+		WW(dst, RW(src));
+		break;
+	case 2:
+		WL(dst, RL(src));
+		break;
+	case 3:
+		WL(dst, RL(src));
+		WL(dst+4, RL(src+4));
+		WL(dst+8, RL(src+8));
+		WL(dst+12, RL(src+12));
+		break;
+	}
+}
+
+// copies the part of an ascending transfer that is direct mapped on both
+// sides, a page span at a time. Memory holds native longs, so both ends
+// must be long aligned. Returns the bytes moved.
+static UINT32 sh2_dmac_bulk(UINT32 src, UINT32 dst, UINT32 len)
+{
+	UINT32 done = 0;
+
+	if ((src | dst) & 3)
+		return 0;
+
+	while (done < len)
+	{
+		unsigned char * ps = SH2_MAP(SH2_MAP_READ, src + done);
+		unsigned char * pd = SH2_MAP(SH2_MAP_WRITE, dst + done);
+		if ((uintptr_t)ps < SH2_MAXHANDLER || (uintptr_t)pd < SH2_MAXHANDLER)
+			break;
+
+		UINT32 s = (src + done) & SH2_PAGEM;
+		UINT32 d = (dst + done) & SH2_PAGEM;
+		UINT32 n = SH2_PAGE_SIZE - (s > d ? s : d);
+		if (n > len - done)
+			n = len - done;
+
+		// the dmac copies forward, a destination just ahead of the source
+		// repeats the data in between
+		ps += s;
+		pd += d;
+		if (pd > ps && (UINT32)(pd - ps) < n)
+			n = (UINT32)(pd - ps) & ~3;
+		if (!n)
+			break;
+
+		memmove(pd, ps, n);
+		done += n;
+	}
+
+	return done;
+}
+
 static void sh2_dmac_check(int dma)
 {
 	if(sh2->m[0x63+4*dma] & sh2->m[0x6c] & 1)
@@ -2789,79 +4222,79 @@ static void sh2_dmac_check(int dma)
 			sh2->dma_timer_active[dma] = 1;
 			sh2->dma_timer_cycles[dma] = 2 * count + 1;
 			sh2->dma_timer_base[dma] = sh2_GetTotalCycles();
+			sh2_event_schedule();
 			
 			src &= AM;
 			dst &= AM;
 
-			switch(size)
+			if(size)
 			{
-			case 0:
-				for(;count > 0; count --)
-				{
-					if(incs == 2)
-						src --;
-					if(incd == 2)
-						dst --;
-					program_write_byte_32be(dst, program_read_byte_32be(src));
-					if(incs == 1)
-						src ++;
-					if(incd == 1)
-						dst ++;
-				}
-				break;
-			case 1:
-				src &= ~1;
-				dst &= ~1;
-				for(;count > 0; count --)
+				src &= ~((size == 1) ? 1 : 3);
+				dst &= ~((size == 1) ? 1 : 3);
+			}
+			if(size == 3)
+				count &= ~3;
+
+			// 16 byte units always step the source up, so an ascending
+			// destination makes them plain long moves
+			if(incd == 1 && (incs == 1 || size == 3))
+			{
+				UINT32 unit = (size == 3) ? 4 : (1 << size);
+				UINT32 len = count * unit;
+
+				if(size == 3)
+					size = 2;
+
+				while(len)
 				{
-					if(incs == 2)
-						src -= 2;
-					if(incd == 2)
-						dst -= 2;
-					program_write_word_32be(dst, program_read_word_32be(src));
-					if(incs == 1)
-						src += 2;
-					if(incd == 1)
-						dst += 2;
+					UINT32 n = sh2_dmac_bulk(src, dst, len & ~3);
+					if(n)
+					{
+						src += n;
+						dst += n;
+						len -= n;
+						continue;
+					}
+
+					// through the handlers up to the next page on either side
+					do
+					{
+						sh2_dmac_unit(size, src, dst);
+						src += unit;
+						dst += unit;
+						len -= unit;
+					}
+					while(len && (src & SH2_PAGEM) >= unit && (dst & SH2_PAGEM) >= unit);
 				}
-				break;
-			case 2:
-				src &= ~3;
-				dst &= ~3;
-				for(;count > 0; count --)
-				{
-					if(incs == 2)
-						src -= 4;
-					if(incd == 2)
-						dst -= 4;
-						
-					//program_write_dword_32be(dst, program_read_dword_32be(src));
-					WL(dst, RL(src));
-					
-					if(incs == 1)
-						src += 4;
-					if(incd == 1)
-						dst += 4;
+				return;
+			}
 
-				}
-				break;
-			case 3:
-				src &= ~3;
-				dst &= ~3;
-				count &= ~3;
+			if(size == 3)
+			{
 				for(;count > 0; count -= 4)
 				{
 					if(incd == 2)
 						dst -= 16;
-					program_write_dword_32be(dst, program_read_dword_32be(src));
-					program_write_dword_32be(dst+4, program_read_dword_32be(src+4));
-					program_write_dword_32be(dst+8, program_read_dword_32be(src+8));
-					program_write_dword_32be(dst+12, program_read_dword_32be(src+12));
+					sh2_dmac_unit(3, src, dst);
 					src += 16;
 					if(incd == 1)
 						dst += 16;
 				}
-				break;
+				return;
+			}
+
+			UINT32 unit = 1 << size;
+			for(;count > 0; count --)
+			{
+				if(incs == 2)
+					src -= unit;
+				if(incd == 2)
+					dst -= unit;
+				sh2_dmac_unit(size, src, dst);
+				if(incs == 1)
+					src += unit;
+				if(incd == 1)
+					dst += unit;
 			}
 		}
 	}
@@ -3065,86 +4498,60 @@ static UINT32 sh2_internal_r(UINT32 offset, UINT32 /*mem_mask*/)
 
 // -------------------------------------------------------
 
-#if USE_JUMPTABLE
-
 int Sh2Run(int cycles)
 {
 	sh2->sh2_icount = cycles;
 	sh2->sh2_cycles_to_run = cycles;
-
+	sh2->sh2_icount_rest = 0;
+	sh2_event_schedule();
+	
 	do
 	{
+
 		if ( pSh2Ext->suspend ) {
 			sh2->sh2_total_cycles += cycles;
 			sh2->sh2_icount = 0;
+			sh2->sh2_icount_rest = 0;
 			break;
-		}
+		}			
 
-		UINT16 opcode;
+#if USE_BLOCK_CACHE
+		SH2BLOCK * blk = NULL;
 
-		if (sh2->delay) {
-			opcode = cpu_readop16(sh2->delay & AM);
-			change_pc(sh2->pc & AM);
-			sh2->delay = 0;
-		} else {
-			opcode = cpu_readop16(sh2->pc & AM);
-			sh2->pc += 2;
+		if (!sh2->delay) {
+			blk = pSh2Ext->cache.block + ((sh2->pc >> 1) & (SH2_BLOCK_COUNT - 1));
+			if (blk->pc != sh2->pc || blk->gen != pSh2Ext->cache.line_gen[SH2_LINE(sh2->pc & AM)])
+				blk = sh2_block_build(sh2->pc);
 		}
 
-		sh2->ppc = sh2->pc;
-
-		opcode_jumptable[opcode](opcode);
+		if (blk) {
+			if (blk->flags & SH2_BLOCK_WATCH)
+				sh2_watch_hit(blk);
 
-		if(sh2->test_irq && !sh2->delay)
-		{
-			CHECK_PENDING_IRQ(/*"mame_sh2_execute"*/);
-			sh2->test_irq = 0;
-		}
-
-		sh2->sh2_icount--;
-		
-		// timer check 
-		
+			pSh2Ext->cache.run_line = SH2_LINE(blk->pc & AM);
+#if USE_SH2_DRC
+			if (EnableSh2Drc)
+				sh2_drc_run(blk);
+			else
+#endif
+			sh2_block_run(blk);
+			pSh2Ext->cache.run_line = SH2_LINE_COUNT;
+
+#if IDLE_LOOP_SKIP
+			if ((blk->flags & SH2_BLOCK_IDLE) && sh2->pc == blk->pc && !sh2->delay && !sh2->test_irq && !pSh2Ext->suspend && sh2->sh2_icount > 0)
+				sh2_idle_skip(blk);
+			else if ((blk->flags & (SH2_BLOCK_HINT | SH2_BLOCK_IDLE)) == SH2_BLOCK_HINT && !sh2->test_irq && !pSh2Ext->suspend && sh2->sh2_icount > 0)
+				sh2_hint_skip(blk);
+#endif
+#if COPY_LOOP_SKIP
+			if ((blk->flags & SH2_BLOCK_COPY_HELD) && sh2->pc != blk->pc)
+				blk->flags = (blk->flags & ~SH2_BLOCK_COPY_HELD) | SH2_BLOCK_COPY;
+			if ((blk->flags & SH2_BLOCK_COPY) && sh2->pc == blk->pc && !sh2->delay && !sh2->test_irq && !pSh2Ext->suspend && sh2->sh2_icount > 0)
+				sh2_copy_skip(blk);
+#endif
+		} else
+#endif
 		{
-			unsigned int cy = sh2_GetTotalCycles();
-
-			if (sh2->dma_timer_active[0])
-				if ((cy - sh2->dma_timer_base[0]) >= sh2->dma_timer_cycles[0])
-					sh2_dmac_callback(0);
-
-			if (sh2->dma_timer_active[1])
-				if ((cy - sh2->dma_timer_base[1]) >= sh2->dma_timer_cycles[1])
-					sh2_dmac_callback(1);
-	
-			if ( sh2->timer_active )
-				if ((cy - sh2->timer_base) >= sh2->timer_cycles)
-					sh2_timer_callback();
-		}
-		
-		
-	} while( sh2->sh2_icount > 0 );
-	
-	sh2->cycle_counts += cycles - (UINT32)sh2->sh2_icount;
-
-	return cycles - sh2->sh2_icount;
-}
-
-#else
-
-int Sh2Run(int cycles)
-{
-	sh2->sh2_icount = cycles;
-	sh2->sh2_cycles_to_run = cycles;
-	
-	do
-	{
-
-		if ( pSh2Ext->suspend ) {
-			sh2->sh2_total_cycles += cycles;
-			sh2->sh2_icount = 0;
-			break;
-		}			
-
 		UINT16 opcode;
 
 		if (sh2->delay) {
@@ -3158,6 +4565,23 @@ int Sh2Run(int cycles)
 
 		sh2->ppc = sh2->pc;
 
+#if USE_COMPUTED_GOTO
+		static const void * const sh2_leaf_label[SH2_LEAF_COUNT] = {
+#define SH2_LEAF_LABEL(name, call)	&&leaf_##name,
+			SH2_LEAF_LIST(SH2_LEAF_LABEL)
+#undef SH2_LEAF_LABEL
+		};
+
+		goto *sh2_leaf_label[sh2_leaf_index[opcode]];
+
+#define SH2_LEAF_CASE(name, call)	leaf_##name: call; goto leaf_done;
+		SH2_LEAF_LIST(SH2_LEAF_CASE)
+#undef SH2_LEAF_CASE
+
+leaf_done:
+#elif USE_JUMPTABLE && USE_TABLE_STEP
+		SH2_HANDLER(opcode)(opcode);
+#else
 		switch (opcode & ( 15 << 12))
 		{
 		case  0<<12: op0000(opcode); break;
@@ -3177,37 +4601,21 @@ int Sh2Run(int cycles)
 		case 14<<12: op1110(opcode); break;
 		default: op1111(opcode); break;
 		}
-
 #endif
 
+		sh2->sh2_total_cycles++;
+		sh2->sh2_icount--;
+		}
+
 		if(sh2->test_irq && !sh2->delay)
 		{
 			CHECK_PENDING_IRQ(/*"mame_sh2_execute"*/);
 			sh2->test_irq = 0;
 		}
-
-		sh2->sh2_total_cycles++;
-		sh2->sh2_icount--;
-		
-		// timer check 
-		
-		{
-			unsigned int cy = sh2_GetTotalCycles();
-
-
-			if (sh2->dma_timer_active[0])
-				if ((cy - sh2->dma_timer_base[0]) >= sh2->dma_timer_cycles[0])
-					sh2_dmac_callback(0);
-
-			if (sh2->dma_timer_active[1])
-				if ((cy - sh2->dma_timer_base[1]) >= sh2->dma_timer_cycles[1])
-					sh2_dmac_callback(1);
-	
-			if ( sh2->timer_active )
-				if ((cy - sh2->timer_base) >= sh2->timer_cycles)
-					sh2_timer_callback();
-		}
 		
+		// end of the slice or a timer deadline
+		if (sh2->sh2_icount <= 0)
+			sh2_event_check();
 		
 	} while( sh2->sh2_icount > 0 );
 	
@@ -3247,13 +4655,15 @@ void Sh2BurnUntilInt(int) { pSh2Ext->suspend = 1; }
 
 void Sh2StopRun(void)
 {
-	sh2->sh2_total_cycles += sh2->sh2_icount;
+	sh2->sh2_total_cycles += sh2->sh2_icount + sh2->sh2_icount_rest;
 	sh2->sh2_icount = 0;
+	sh2->sh2_icount_rest = 0;
 	sh2->sh2_cycles_to_run = 0;
 }
 
-int Sh2TotalCycles(void) { return sh2->sh2_total_cycles; }
-void Sh2NewFrame(void) { sh2->sh2_total_cycles = 0; }
+// cycles run since Sh2NewFrame, exact inside a slice so handlers can time themselves
+int Sh2TotalCycles(void) { return (int)(sh2_GetTotalCycles() - sh2->frame_base); }
+void Sh2NewFrame(void) { sh2->frame_base = sh2_GetTotalCycles(); }
 
 void Sh2BurnCycles(int cycles)
 {
@@ -3279,27 +4689,51 @@ void Sh2Reset()
 
 #include "state.h"
 
+static void sh2_scan_context(SH2EXT * ctx, int nAction, char * szText)
+{
+	SH2EXT * prev = Sh2SetContext(ctx);
+
+	ScanVar(& ( pSh2Ext->sh2 ), offsetof(SH2, irq_callback), szText);
+	
+	SCAN_VAR (pSh2Ext->suspend);
+	
+#if FAST_OP_FETCH
+	//	pSh2Ext->opbase
+	if (nAction & ACB_WRITE) {
+		change_pc(sh2->pc & AM);
+	}
+#endif
+
+#if USE_BLOCK_CACHE
+	if (nAction & ACB_WRITE)
+		sh2_cache_flush();
+#endif
+
+	Sh2SetContext(prev);
+}
+
 int Sh2Scan(int nAction)
 {
 	if (nAction & ACB_DRIVER_DATA) {
 	
 		char szText[] = "SH2 #0";
 
-		for (int i = 0; i < 1 /*nCPUCount*/; i++) {
+		for (int i = 0; i < nSh2Count; i++) {
 			szText[5] = '1' + i;
-         ScanVar(& ( Sh2Ext[i].sh2 ), offsetof(SH2, irq_callback), szText);
-			
-			SCAN_VAR (Sh2Ext[i].suspend);
-			
-#if FAST_OP_FETCH
-			//	Sh2Ext[i].opbase
-			if (nAction & ACB_WRITE) {
-				change_pc(sh2->pc & AM);
-			}
-#endif
+			sh2_scan_context(Sh2Ext + i, nAction, szText);
 		}
 
 	}
 	
 	return 0;
 }
+
+int Sh2ContextScan(Sh2Context * ctx, int nAction)
+{
+	if (nAction & ACB_DRIVER_DATA) {
+		char szText[] = "SH2";
+		sh2_scan_context(ctx, nAction, szText);
+	}
+
+	return 0;
+}
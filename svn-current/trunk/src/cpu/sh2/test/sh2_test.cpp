@@ -0,0 +1,872 @@
+// Differential test for the SH-2 core. Random programs with subroutines,
+// delayed branches, counted and busy loops, copy loops, self modifying
+// code, traps, irq handlers and the on chip timer and dma run in slices of
+// random length with irqs raised in between. After every slice the
+// registers, cycle counters and every access that reached the io handlers
+// go into a running digest, main ram too when it is printed every 100
+// slices.
+//
+// "make -f makefile.libretro test" builds this once as the plain switch
+// interpreter and once for each of the table, computed goto, block cache
+// and recompiler paths, and each has to print what the switch build does.
+// Programs that idle in a ram poll loop are only compared between the
+// builds that skip such loops, skipping rounds the cycle count differently.
+//
+//   sh2_test [idle] [reference]   prints the digests, or checks them
+//   sh2_test bench                SH-2 cycles per second of this build
+
+#include "../sh2.cpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// what the core needs from the rest of the emulator
+void CpuCheatRegister(INT32, cpu_core_config *) {}
+INT32 (__cdecl *BurnAcb)(struct BurnArea * pba) = NULL;
+static INT32 __cdecl test_bprintf(INT32, const TCHAR *, ...) { return 0; }
+INT32 (__cdecl *bprintf)(INT32 nStatus, const TCHAR * szFormat, ...) = test_bprintf;
+
+#if USE_SH2_DRC
+#define SH2_PATH	"recompiler"
+#elif USE_BLOCK_CACHE
+#define SH2_PATH	"block cache"
+#elif USE_COMPUTED_GOTO
+#define SH2_PATH	"computed goto"
+#elif USE_JUMPTABLE && USE_TABLE_STEP
+#define SH2_PATH	"table"
+#else
+#define SH2_PATH	"switch"
+#endif
+
+#define ROM_BASE	0x06000000
+#define ROM_SIZE	0x01000000
+#define BIOS_SIZE	0x00080000
+#define RAM_SIZE	0x00080000
+
+enum { OPT_COPY = 1, OPT_NOBUSY = 2, OPT_POLL = 4, OPT_RAMIDLE = 8, OPT_TIMER = 16, OPT_BIG = 32, OPT_NOPATCH = 64 };
+
+static UINT8 * Rom;
+static UINT8 * Bios;
+static UINT8 * Ram;
+
+static UINT32 rng;
+
+static UINT32 rnd32()
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static INT32 rnd(INT32 n) { return rnd32() % n; }
+static INT32 rnd_range(INT32 lo, INT32 hi) { return lo + rnd(hi - lo); }
+static INT32 chance(INT32 percent) { return rnd(100) < percent; }
+
+// memory is kept as the core sees it, 32 bit words in host order
+static void w16(UINT8 * buf, UINT32 off, UINT16 v)
+{
+#ifdef MSB_FIRST
+	*(UINT16 *)(buf + off) = v;
+#else
+	*(UINT16 *)(buf + (off ^ 2)) = v;
+#endif
+}
+
+static void w32(UINT8 * buf, UINT32 off, UINT32 v)
+{
+	*(UINT32 *)(buf + off) = v;
+}
+
+//-- assembler ------------------------------------------------------
+
+enum { BR_BT, BR_BF, BR_BTS, BR_BFS, BR_BRA, BR_BSR };
+
+#define ASM_OPS		0x10000
+#define ASM_LABELS	0x4000
+
+struct Asm
+{
+	UINT32 base;
+	INT32 count;
+	UINT16 code[ASM_OPS];
+	INT32 fixes;
+	struct { INT32 at, kind, label; } fix[ASM_LABELS];
+};
+
+static UINT32 label_pc[ASM_LABELS];
+static INT32 labels;
+
+static UINT32 asm_pc(Asm * a) { return a->base + a->count * 2; }
+
+static void asm_op(Asm * a, UINT16 op)
+{
+	if (a->count == ASM_OPS) {
+		printf("sh2_test: program too long\n");
+		exit(1);
+	}
+	a->code[a->count++] = op;
+}
+
+static void asm_align4(Asm * a)
+{
+	if (asm_pc(a) & 2)
+		asm_op(a, 0x0009);
+}
+
+static INT32 asm_label() { return labels++; }
+static void asm_bind(Asm * a, INT32 l) { label_pc[l] = asm_pc(a); }
+
+static void asm_br(Asm * a, INT32 kind, INT32 l)
+{
+	a->fix[a->fixes].at = a->count;
+	a->fix[a->fixes].kind = kind;
+	a->fix[a->fixes++].label = l;
+	asm_op(a, 0);
+}
+
+// MOV.L @(disp,PC),Rn with the literal after a BRA over it
+static void asm_lit(Asm * a, INT32 n, UINT32 value)
+{
+	asm_align4(a);
+	INT32 at = a->count;
+	UINT32 mov = asm_pc(a);
+	asm_op(a, 0);
+	asm_op(a, 0);
+	asm_op(a, 0x0009);
+	asm_align4(a);
+	UINT32 lit = asm_pc(a);
+	asm_op(a, value >> 16);
+	asm_op(a, value & 0xffff);
+
+	a->code[at] = 0xd000 | (n << 8) | ((lit - ((mov + 4) & ~3)) / 4);
+	a->code[at + 1] = 0xa000 | (((INT32)(asm_pc(a) - (mov + 6)) / 2) & 0xfff);
+}
+
+static void asm_emit(Asm * a, UINT8 * buf, UINT32 off)
+{
+	static const UINT16 cond[4] = { 0x8900, 0x8b00, 0x8d00, 0x8f00 };
+
+	for (INT32 i = 0; i < a->fixes; i++) {
+		UINT32 pc = a->base + a->fix[i].at * 2;
+		INT32 d = ((INT32)label_pc[a->fix[i].label] - (INT32)(pc + 4)) / 2;
+
+		if (a->fix[i].kind <= BR_BFS)
+			a->code[a->fix[i].at] = cond[a->fix[i].kind] | (d & 0xff);
+		else
+			a->code[a->fix[i].at] = (a->fix[i].kind == BR_BRA ? 0xa000 : 0xb000) | (d & 0xfff);
+	}
+
+	for (INT32 i = 0; i < a->count; i++)
+		w16(buf, off + i * 2, a->code[i]);
+}
+
+//-- program generator ----------------------------------------------
+
+// r0-r10 are free, r11 counts loops, r12 and r13 point into ram, r15 is the stack
+static INT32 reg() { return rnd(11); }
+
+static UINT16 rand_alu()
+{
+	static const UINT8 shifts[] = { 0x20, 0x21, 0x00, 0x01, 0x08, 0x09, 0x18, 0x19, 0x28, 0x29 };
+	static const UINT8 cmps[] = { 0, 2, 3, 6, 7 };
+	static const UINT8 sys[] = { 0x00, 0x10, 0x20 };
+	INT32 n = reg() << 8, m = rnd(16) << 4;
+
+	switch (rnd(54)) {
+		case  0: return 0x300c | n | m;		// add
+		case  1: return 0x7000 | n | rnd(256);
+		case  2: return 0x300e | n | m;		// addc
+		case  3: return 0x300f | n | m;		// addv
+		case  4: return 0x2009 | n | m;		// and
+		case  5: return 0xc900 | rnd(256);
+		case  6: return 0x8800 | rnd(256);	// cmp/eq #imm
+		case  7: return 0x3000 | n | m | cmps[rnd(5)];
+		case  8: return 0x4015 | n;			// cmp/pl
+		case  9: return 0x4011 | n;			// cmp/pz
+		case 10: return 0x200c | n | m;		// cmp/str
+		case 11: return 0x2007 | n | m;		// div0s
+		case 12: return 0x0019;				// div0u
+		case 13: return 0x3004 | n | m;		// div1
+		case 14: return 0x300d | n | m;		// dmuls
+		case 15: return 0x3005 | n | m;		// dmulu
+		case 16: return 0x600e | n | m | rnd(2);	// exts
+		case 17: return 0x600c | n | m | rnd(2);	// extu
+		case 18: return 0x6003 | n | m;		// mov
+		case 19: return 0xe000 | n | rnd(256);
+		case 20: return 0x0029 | n;			// movt
+		case 21: return 0x0007 | n | m;		// mul.l
+		case 22: return 0x200f | n | m;		// muls
+		case 23: return 0x200e | n | m;		// mulu
+		case 24: return 0x600b | n | m;		// neg
+		case 25: return 0x600a | n | m;		// negc
+		case 26: return 0x6007 | n | m;		// not
+		case 27: return 0x0009;
+		case 28: return 0x200b | n | m;		// or
+		case 29: return 0xcb00 | rnd(256);
+		case 30: return 0x4024 | n;			// rotcl
+		case 31: return 0x4025 | n;			// rotcr
+		case 32: return 0x4004 | n;			// rotl
+		case 33: return 0x4005 | n;			// rotr
+		case 34: return 0x0018;				// sett
+		case 35: return 0x0008;				// clrt
+		case 36: return 0x0028;				// clrmac
+		case 37: return 0x4000 | n | shifts[rnd(10)];
+		case 38: return 0x0002 | n | sys[rnd(3)];	// stc
+		case 39: return 0x000a | n | sys[rnd(2)];	// sts mach, macl
+		case 40: return 0x3008 | n | m;		// sub
+		case 41: return 0x300a | n | m;		// subc
+		case 42: return 0x300b | n | m;		// subv
+		case 43: return 0x6008 | n | m;		// swap.b
+		case 44: return 0x6009 | n | m;		// swap.w
+		case 45: return 0x2008 | n | m;		// tst
+		case 46: return 0xc800 | rnd(256);
+		case 47: return 0x200a | n | m;		// xor
+		case 48: return 0xca00 | rnd(256);
+		case 49: return 0x200d | n | m;		// xtrct
+		case 50: return 0x400a | n | sys[rnd(2)];	// lds mach, macl
+		case 51: return 0xc700 | rnd(256);	// mova
+		case 52: return 0x9000 | n | rnd(256);	// mov.w @(disp,pc)
+	}
+	return 0xd000 | n | rnd(256);			// mov.l @(disp,pc)
+}
+
+static UINT16 rand_mem()
+{
+	static const UINT8 sts[] = { 0x00, 0x10, 0x20 };
+	INT32 n = reg(), p = 12 + rnd(2), q = 25 - p;
+
+	switch (rnd(18)) {
+		case  0: return 0x2000 | p << 8 | n << 4 | rnd(3);		// mov.x rm,@rn
+		case  1: return 0x6000 | n << 8 | p << 4 | rnd(3);		// mov.x @rm,rn
+		case  2: return 0x2004 | p << 8 | n << 4 | rnd(3);		// mov.x rm,@-rn
+		case  3: return 0x6004 | n << 8 | p << 4 | rnd(3);		// mov.x @rm+,rn
+		case  4: return 0x1000 | p << 8 | n << 4 | rnd(16);		// mov.l rm,@(disp,rn)
+		case  5: return 0x5000 | n << 8 | p << 4 | rnd(16);		// mov.l @(disp,rm),rn
+		case  6: return 0x8000 | p << 4 | rnd(16);				// mov.b r0,@(disp,rn)
+		case  7: return 0x8100 | p << 4 | rnd(16);
+		case  8: return 0x8400 | p << 4 | rnd(16);				// mov.b @(disp,rm),r0
+		case  9: return 0x8500 | p << 4 | rnd(16);
+		case 10: return 0xc000 | rnd(3) << 8 | rnd(256);		// gbr stores
+		case 11: return 0xc400 | rnd(3) << 8 | rnd(256);		// gbr loads
+		case 12: return 0x000f | p << 8 | q << 4;				// mac.l
+		case 13: return 0x400f | p << 8 | q << 4;				// mac.w
+		case 14: return 0x401b | p << 8;						// tas.b
+		case 15: return 0x4002 | p << 8 | sts[rnd(3)];			// sts.l x,@-rn
+		case 16: return 0x4003 | p << 8 | sts[1 + rnd(2)];		// stc.l gbr/vbr,@-rn
+	}
+	return 0x4006 | p << 8 | sts[rnd(2)];						// lds.l @rn+,mach/macl
+}
+
+static UINT16 rand_op()
+{
+	return chance(35) ? rand_mem() : rand_alu();
+}
+
+// a DT counted loop moving data between r12 and r13, at times over the
+// data at the end of rom, the io handlers or an unmapped area
+static void copy_loop(Asm * a)
+{
+	static const INT32 sizes[] = { 1, 2, 4, 4 };
+	INT32 sz = sizes[rnd(4)], s = sz >> 1;
+	INT32 ps = 12 + rnd(2), pd = 25 - ps;
+	INT32 v = 1 + rnd(3);
+	INT32 fill = chance(30);
+	INT32 r = rnd(100);
+
+	if (r < 15) {
+		static const UINT32 dst[] = { 0, 0x04000000, 0x22001000 };
+		UINT32 d = dst[rnd(3)];
+		asm_lit(a, pd, d ? d : ROM_BASE + 0xf20000 + rnd(0x100) * 4);
+	} else if (r < 30) {
+		static const UINT32 src[] = { 0, 0x04000000, 0x22010000 };
+		UINT32 d = src[rnd(3)];
+		asm_lit(a, ps, d ? d : ROM_BASE + 0xf20000 + rnd(0x1000) * 4);
+	} else if (r < 45) {
+		asm_lit(a, pd, 0x02020000 + rnd_range(-16, 16) * sz);
+		asm_lit(a, ps, 0x02020000);
+	} else if (r < 50) {
+		asm_lit(a, pd, 0x0200fff0 + rnd(8) * sz);
+	}
+	if (chance(10))
+		asm_lit(a, ps, 0x02030001);
+
+	if (chance(60))
+		asm_op(a, 0xeb00 | rnd_range(chance(97) ? 1 : 0, 128));
+	else
+		asm_lit(a, 11, rnd_range(1, 3000));
+	if (fill)
+		asm_op(a, 0xe000 | v << 8 | rnd(256));
+
+	INT32 up_s = chance(80), up_d = chance(75);
+	UINT16 body[8];
+	INT32 n = 0;
+
+	if (!fill) {
+		if (up_s && chance(70)) {
+			body[n++] = 0x6004 | v << 8 | ps << 4 | s;
+		} else {
+			body[n++] = 0x6000 | v << 8 | ps << 4 | s;
+			body[n++] = 0x7000 | ps << 8 | ((up_s ? sz : -sz) & 0xff);
+		}
+	}
+	if (!up_d && chance(70)) {
+		body[n++] = 0x2004 | pd << 8 | v << 4 | s;
+	} else {
+		body[n++] = 0x2000 | pd << 8 | v << 4 | s;
+		body[n++] = 0x7000 | pd << 8 | ((up_d ? sz : -sz) & 0xff);
+	}
+
+	UINT16 extra[3] = { 0x4b10, 0, 0 };		// dt r11
+	INT32 extras = 1;
+	if (chance(15))
+		extra[extras++] = rand_op();
+	if (chance(10))
+		extra[extras++] = 0x0009;
+	for (INT32 i = 0; i < extras; i++) {
+		INT32 at = rnd(n + 1);
+		memmove(body + at + 1, body + at, (n - at) * sizeof(UINT16));
+		body[at] = extra[i];
+		n++;
+	}
+	if (chance(10)) {
+		for (INT32 i = n - 1; i > 0; i--) {
+			INT32 j = rnd(i + 1);
+			UINT16 t = body[i]; body[i] = body[j]; body[j] = t;
+		}
+	}
+
+	INT32 l = asm_label();
+	asm_bind(a, l);
+	if (chance(50) || n < 2) {
+		for (INT32 i = 0; i < n; i++)
+			asm_op(a, body[i]);
+		asm_br(a, BR_BF, l);
+	} else {
+		for (INT32 i = 0; i < n - 1; i++)
+			asm_op(a, body[i]);
+		asm_br(a, BR_BFS, l);
+		asm_op(a, body[n - 1]);
+	}
+}
+
+static void chunk(Asm * a, INT32 opts)
+{
+	asm_lit(a, 12, 0x02001000 + rnd(0x40) * 0x100);
+	asm_lit(a, 13, 0x02010000 + rnd(0x40) * 0x100);
+
+	INT32 sub = -1;
+	if (chance(30)) {
+		INT32 over = asm_label();
+		sub = asm_label();
+		asm_br(a, BR_BRA, over);
+		asm_op(a, rand_op());
+		asm_bind(a, sub);
+		for (INT32 i = rnd_range(1, 6); i > 0; i--)
+			asm_op(a, rand_op());
+		asm_op(a, 0x000b);					// rts
+		asm_op(a, rand_op());
+		asm_bind(a, over);
+	}
+
+	for (INT32 items = rnd_range(3, 12); items > 0; items--) {
+		INT32 k = rnd(100);
+
+		if ((opts & OPT_COPY) && chance(40)) {
+			copy_loop(a);
+		} else if (k < 45) {
+			for (INT32 i = rnd_range(1, 8); i > 0; i--)
+				asm_op(a, rand_op());
+		} else if (k < 60) {
+			// forward skip, the delayed ones with their slot
+			INT32 kind = rnd(5), l = asm_label();
+			asm_op(a, rand_alu());
+			asm_br(a, kind, l);
+			if (kind >= BR_BTS)
+				asm_op(a, rand_op());
+			for (INT32 i = rnd(5); i > 0; i--)
+				asm_op(a, rand_op());
+			asm_bind(a, l);
+		} else if (k < 72) {
+			// counted loop, dt r11 and bf or bf/s
+			asm_op(a, 0xeb00 | rnd_range(1, 20));
+			INT32 l = asm_label();
+			asm_bind(a, l);
+			for (INT32 i = rnd_range((opts & OPT_NOBUSY) ? 1 : 0, 6); i > 0; i--)
+				asm_op(a, rand_op());
+			asm_op(a, 0x4b10);
+			if (chance(50)) {
+				asm_br(a, BR_BF, l);
+			} else {
+				asm_br(a, BR_BFS, l);
+				asm_op(a, rand_op());
+			}
+		} else if (k < 76 && (opts & OPT_NOBUSY)) {
+			asm_op(a, rand_op());
+		} else if (k < 76) {
+			// dt r11, bf $-2
+			asm_op(a, 0xeb00 | rnd_range(1, 120));
+			asm_op(a, 0x4b10);
+			asm_op(a, 0x8bfd);
+		} else if (k < 80 && sub >= 0) {
+			asm_br(a, BR_BSR, sub);
+			asm_op(a, rand_op());
+		} else if (k < 84) {
+			// braf or bsrf over a few ops
+			INT32 skip = rnd(4);
+			asm_op(a, 0xea00 | (skip * 2));
+			asm_op(a, chance(50) ? 0x0a23 : 0x0a03);
+			asm_op(a, 0x0009);
+			for (INT32 i = skip; i > 0; i--)
+				asm_op(a, rand_op());
+		} else if (k < 88 && (opts & OPT_NOPATCH)) {
+			asm_op(a, rand_op());
+		} else if (k < 86) {
+			// rewrite the patch routine in rom and call it
+			asm_lit(a, 10, ROM_BASE + 0xf80000);
+			asm_lit(a, 9, ((0xe100 | rnd(256)) << 16) | 0x000b);
+			asm_op(a, 0x2a92);				// mov.l r9,@r10
+			asm_op(a, 0x4a0b);				// jsr @r10
+			asm_op(a, 0x0009);
+		} else if (k < 88) {
+			// rewrite the two ops after the store, they run as written
+			asm_lit(a, 9, ((0xe100 | rnd(256)) << 16) | 0x0009);
+			asm_lit(a, 10, 0);
+			a->code[a->count - 2] = (asm_pc(a) + 4) >> 16;
+			a->code[a->count - 1] = (asm_pc(a) + 4) & 0xffff;
+			asm_op(a, 0x2a92);				// mov.l r9,@r10
+			asm_op(a, 0x0009);
+			asm_op(a, 0xe100 | rnd(256));	// mov #imm,r1
+			asm_op(a, 0x0009);
+		} else if (k < 90) {
+			asm_op(a, 0xc320 + rnd(2));		// trapa #0x20, #0x21
+		} else if (k < 92 && (opts & OPT_POLL)) {
+			// poll an io port the irq handlers set, the handler burns until an irq
+			asm_lit(a, 8, 0x02070000);
+			asm_op(a, 0xe000);
+			asm_op(a, 0x2802);				// mov.l r0,@r8
+			asm_lit(a, 7, 0x04000010);
+			INT32 l = asm_label();
+			asm_bind(a, l);
+			asm_op(a, 0x6072);				// mov.l @r7,r0
+			asm_op(a, 0x2008);				// tst r0,r0
+			asm_br(a, BR_BT, l);
+		} else if (k < 92 && (opts & OPT_RAMIDLE)) {
+			// poll a ram flag the irq handlers set
+			asm_lit(a, 8, 0x02070000);
+			asm_op(a, 0xe000);
+			asm_op(a, 0x2802);
+			INT32 l = asm_label();
+			asm_bind(a, l);
+			asm_op(a, 0x6082);				// mov.l @r8,r0
+			asm_op(a, 0x2008);
+			asm_br(a, BR_BT, l);
+		} else if (k < 95 && (opts & OPT_TIMER)) {
+			// dma channel 0, longs from ram to ram with an irq at the end
+			asm_lit(a, 1, 0xffffff80); asm_lit(a, 0, 0x02040000 + rnd(0x100) * 4); asm_op(a, 0x2102);
+			asm_lit(a, 1, 0xffffff84); asm_lit(a, 0, 0x02050000 + rnd(0x100) * 4); asm_op(a, 0x2102);
+			asm_lit(a, 1, 0xffffff88); asm_lit(a, 0, rnd_range(1, 300)); asm_op(a, 0x2102);
+			asm_lit(a, 1, 0xffffff8c); asm_lit(a, 0, 0x5 | (2 << 10) | (1 << 12) | (1 << 14)); asm_op(a, 0x2102);
+		} else if (k < 97 && (opts & OPT_TIMER)) {
+			// store the free running counter
+			asm_lit(a, 1, 0xfffffe12);
+			asm_op(a, 0x6011);				// mov.w @r1,r0
+			asm_lit(a, 2, 0x02070200 + rnd(16) * 4);
+			asm_op(a, 0x2202);
+		} else {
+			for (INT32 i = rnd_range(1, 4); i > 0; i--)
+				asm_op(a, rand_op());
+		}
+	}
+}
+
+// saves r0-r3, acks the line at the io port, sets the ram flag the idle
+// loops wait on and does a little work
+static void irq_handler(Asm * a, INT32 line)
+{
+	static const UINT16 work[] = { 0x300c, 0x2009, 0x200a, 0x6003, 0x3008 };
+
+	for (INT32 r = 0; r < 4; r++)
+		asm_op(a, 0x2f06 | r << 4);			// mov.l rn,@-r15
+	asm_op(a, 0x2f36);
+	asm_op(a, 0xe000 | line);
+	asm_lit(a, 1, 0x04000000);
+	asm_op(a, 0x2102);
+	asm_lit(a, 2, 0x02070000);
+	asm_op(a, 0xe301);
+	asm_op(a, 0x2232);
+	for (INT32 i = rnd(8); i > 0; i--)
+		asm_op(a, work[rnd(5)] | rnd(4) << 8 | rnd(4) << 4);
+	asm_op(a, 0x63f6);
+	for (INT32 r = 3; r >= 0; r--)
+		asm_op(a, 0x60f6 | r << 8);			// mov.l @r15+,rn
+	asm_op(a, 0x002b);						// rte
+	asm_op(a, 0x0009);
+}
+
+// counts its calls and the frc at counter, then clears the frt flags or
+// the dma end flag, the vcr write makes the core look at its irqs again
+static void chip_handler(Asm * a, UINT32 counter, INT32 dma)
+{
+	for (INT32 r = 0; r < 4; r++)
+		asm_op(a, 0x2f06 | r << 4);
+	asm_lit(a, 1, 0xfffffe12);
+	asm_op(a, 0x6011);
+	asm_lit(a, 2, counter);
+	asm_op(a, 0x6322);
+	asm_op(a, 0x330c);
+	asm_op(a, 0x7301);
+	asm_op(a, 0x2232);
+	asm_op(a, 0xe000);
+	if (dma) {
+		asm_lit(a, 1, 0xffffff8c);
+		asm_op(a, 0x2102);					// chcr0
+		asm_lit(a, 1, 0xffffffa0);
+		asm_lit(a, 0, 0x52000000);
+		asm_op(a, 0x2102);					// vcrdma0
+	} else {
+		asm_lit(a, 1, 0xfffffe11);
+		asm_op(a, 0x2100);					// ftcsr
+	}
+	for (INT32 r = 3; r >= 0; r--)
+		asm_op(a, 0x60f6 | r << 8);
+	asm_op(a, 0x002b);
+	asm_op(a, 0x0009);
+}
+
+static Asm prog;
+
+static void generate(UINT32 seed, INT32 opts)
+{
+	Asm * a = &prog;
+
+	rng = seed * 2654435761u + 1;
+	labels = 0;
+	memset(Rom, 0, ROM_SIZE);
+	memset(Bios, 0, BIOS_SIZE);
+
+	memset(a, 0, sizeof(Asm));
+	a->base = ROM_BASE;
+	asm_lit(a, 0, 0x02060000);
+	asm_op(a, 0x401e);						// ldc r0,gbr
+	asm_lit(a, 15, 0x0207ff00);
+	asm_op(a, 0xe000);
+	asm_op(a, 0x400e);						// ldc r0,sr
+
+	if (opts & OPT_TIMER) {
+		// frt compare match a and dma channel 0 irqs
+		const UINT32 init[7][2] = {
+			{ 0xfffffe60, 0x0b000000 }, { 0xfffffe64, 0x00000050 },
+			{ 0xfffffe14, ((UINT32)rnd_range(0x20, 0x400) << 16) | (rnd(3) << 8) },
+			{ 0xfffffe10, 0x08010000 }, { 0xfffffee0, 0x00000900 },
+			{ 0xffffffa0, 0x52000000 }, { 0xffffffb0, 0x00000001 }
+		};
+		for (INT32 i = 0; i < 7; i++) {
+			asm_lit(a, 1, init[i][0]);
+			asm_lit(a, 0, init[i][1]);
+			asm_op(a, 0x2102);
+		}
+	}
+
+	for (INT32 i = (opts & OPT_BIG) ? 200 : 40; i > 0; i--)
+		chunk(a, opts);
+	asm_lit(a, 10, ROM_BASE);
+	asm_op(a, 0x4a2b);						// jmp @r10
+	asm_op(a, 0x0009);
+	asm_emit(a, Rom, 0);
+
+	memset(a, 0, sizeof(Asm));
+	a->base = ROM_BASE + 0xf00000;
+	irq_handler(a, 10);
+	asm_emit(a, Rom, 0xf00000);
+
+	memset(a, 0, sizeof(Asm));
+	a->base = ROM_BASE + 0xf01000;
+	irq_handler(a, 12);
+	asm_emit(a, Rom, 0xf01000);
+
+	memset(a, 0, sizeof(Asm));
+	a->base = ROM_BASE + 0xf02000;
+	for (INT32 i = rnd(6); i > 0; i--)
+		asm_op(a, rand_alu());
+	asm_op(a, 0x002b);
+	asm_op(a, rand_alu());
+	asm_emit(a, Rom, 0xf02000);
+
+	if (opts & OPT_TIMER) {
+		memset(a, 0, sizeof(Asm));
+		a->base = ROM_BASE + 0xf03000;
+		chip_handler(a, 0x02070100, 0);
+		asm_emit(a, Rom, 0xf03000);
+
+		memset(a, 0, sizeof(Asm));
+		a->base = ROM_BASE + 0xf04000;
+		chip_handler(a, 0x02070108, 1);
+		asm_emit(a, Rom, 0xf04000);
+
+		w32(Bios, 0x50 * 4, ROM_BASE + 0xf03000);
+		w32(Bios, 0x52 * 4, ROM_BASE + 0xf04000);
+	}
+
+	// the routine the programs patch and call: mov #imm,r1; rts; nop
+	w32(Rom, 0xf80000, (0xe100 << 16) | 0x000b);
+	w16(Rom, 0xf80004, 0x0009);
+
+	w32(Bios, 0, ROM_BASE);
+	w32(Bios, 4, 0x0207ff00);
+	w32(Bios, 69 * 4, ROM_BASE + 0xf00000);
+	w32(Bios, 70 * 4, ROM_BASE + 0xf01000);
+	w32(Bios, 0x20 * 4, ROM_BASE + 0xf02000);
+	w32(Bios, 0x21 * 4, ROM_BASE + 0xf02000);
+}
+
+//-- machine --------------------------------------------------------
+
+static UINT32 iolog;
+
+static void io_log(UINT32 v) { iolog = (iolog ^ v) * 16777619u; }
+
+static UINT8 __fastcall io_read_byte(UINT32 a) { io_log(a); return 0; }
+static UINT16 __fastcall io_read_word(UINT32 a) { io_log(a); return 0; }
+
+static UINT32 __fastcall io_read_long(UINT32 a)
+{
+	a &= 0xc7ffffff;
+	io_log(a);
+
+	if (a == 0x04000010) {
+		UINT32 v = *(UINT32 *)(Ram + 0x70000);
+		if (v == 0)
+			Sh2BurnUntilInt(0);
+		return v;
+	}
+	return 0;
+}
+
+static void __fastcall io_write_byte(UINT32 a, UINT8 d) { io_log(a * 7 + d); }
+static void __fastcall io_write_word(UINT32 a, UINT16 d) { io_log(a * 7 + d); }
+
+static void __fastcall io_write_long(UINT32 a, UINT32 d)
+{
+	a &= 0xc7ffffff;
+	io_log(a * 7 + d);
+
+	if (a == 0x04000000)
+		Sh2SetIRQLine(d & 15, SH2_IRQSTATUS_NONE);
+}
+
+// rom takes long writes only, the code cached from it has to go
+static void __fastcall rom_write_byte(UINT32, UINT8) {}
+static void __fastcall rom_write_word(UINT32, UINT16) {}
+
+static void __fastcall rom_write_long(UINT32 a, UINT32 d)
+{
+	a &= 0x00fffffc;
+	*(UINT32 *)(Rom + a) = d;
+	Sh2InvalidateCode(ROM_BASE + a, ROM_BASE + a + 3);
+}
+
+static UINT32 fnv(const UINT8 * p, INT32 len, UINT32 h)
+{
+	for (INT32 i = 0; i < len; i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+static void machine_init()
+{
+	Sh2Init(1);
+	Sh2Open(0);
+	Sh2MapMemory(Bios, 0x00000000, 0x0007ffff, SH2_ROM);
+	Sh2MapMemory(Ram, 0x02000000, 0x0207ffff, SH2_RAM);
+	Sh2MapMemory(Rom, 0x06000000, 0x06ffffff, SH2_ROM);
+	Sh2MapHandler(1, 0x06000000, 0x06ffffff, SH2_WRITE);
+
+	Sh2SetReadByteHandler(0, io_read_byte);
+	Sh2SetReadWordHandler(0, io_read_word);
+	Sh2SetReadLongHandler(0, io_read_long);
+	Sh2SetWriteByteHandler(0, io_write_byte);
+	Sh2SetWriteWordHandler(0, io_write_word);
+	Sh2SetWriteLongHandler(0, io_write_long);
+	Sh2SetWriteByteHandler(1, rom_write_byte);
+	Sh2SetWriteWordHandler(1, rom_write_word);
+	Sh2SetWriteLongHandler(1, rom_write_long);
+
+	memset(Ram, 0, RAM_SIZE);
+	iolog = 0;
+	Sh2Reset();
+}
+
+// runs a program, hands each printed digest line to out
+static void run(const char * name, INT32 slices, void (*out)(const char * line))
+{
+	UINT32 digest = 2166136261u;
+	long long total = 0;
+	char line[256];
+
+	machine_init();
+
+	for (INT32 s = 0; s < slices; s++) {
+		total += Sh2Run(50 + rnd(4000));
+
+		switch (rnd(16)) {
+			case 0: Sh2SetIRQLine(10, SH2_IRQSTATUS_AUTO); break;
+			case 1: Sh2SetIRQLine(12, SH2_IRQSTATUS_AUTO); break;
+		}
+
+		UINT32 st[27];
+		for (INT32 i = 0; i < 16; i++)
+			st[i] = sh2->r[i];
+		st[16] = sh2->sr;   st[17] = sh2->pc;   st[18] = sh2->pr;
+		st[19] = sh2->gbr;  st[20] = sh2->vbr;  st[21] = sh2->mach;
+		st[22] = sh2->macl; st[23] = sh2->delay;
+		st[24] = sh2->sh2_total_cycles;
+		st[25] = sh2->sh2_icount;
+		st[26] = sh2->cycle_counts;
+
+		digest = fnv((UINT8 *)st, sizeof(st), digest);
+		digest = fnv((UINT8 *)&iolog, sizeof(iolog), digest);
+
+		if ((s % 100) == 99 || s == slices - 1) {
+			digest = fnv(Ram, RAM_SIZE, digest);
+			sprintf(line, "%s slice %d: digest %08x cycles %lld pc %08x", name, s, digest, total, st[17]);
+			out(line);
+		}
+	}
+
+	Sh2Exit();
+}
+
+//-- driver ---------------------------------------------------------
+
+static FILE * reference;
+static INT32 lines, failed;
+
+static void print_line(const char * line)
+{
+	printf("%s\n", line);
+}
+
+static void check_line(const char * line)
+{
+	char expect[256];
+
+	lines++;
+	if (failed)
+		return;
+	if (fgets(expect, sizeof(expect), reference) == NULL) {
+		printf("sh2_test (" SH2_PATH "): reference ends before %s\n", line);
+		failed = 1;
+		return;
+	}
+	expect[strcspn(expect, "\n")] = 0;
+	if (strcmp(expect, line)) {
+		printf("sh2_test (" SH2_PATH "): %s\n                 expected %s\n", line, expect);
+		failed = 1;
+	}
+}
+
+static const struct { const char * name; INT32 opts; } programs[] = {
+	{ "plain",        0 },
+	{ "nobusy",       OPT_NOBUSY },
+	{ "copy",         OPT_COPY },
+	{ "poll",         OPT_POLL },
+	{ "timer",        OPT_TIMER },
+	{ "timer copy",   OPT_TIMER | OPT_COPY },
+	{ "timer poll",   OPT_TIMER | OPT_POLL },
+	{ "big copy",     OPT_BIG | OPT_COPY | OPT_POLL },
+};
+
+static const struct { const char * name; INT32 opts; } idle_programs[] = {
+	{ "ramidle",      OPT_RAMIDLE },
+	{ "ramidle copy", OPT_RAMIDLE | OPT_COPY | OPT_TIMER },
+};
+
+#define SEEDS	4
+#define SLICES	1500
+
+static void run_all(INT32 idle, void (*out)(const char * line))
+{
+	INT32 count = idle ? sizeof(idle_programs) / sizeof(idle_programs[0]) : sizeof(programs) / sizeof(programs[0]);
+
+	for (INT32 p = 0; p < count; p++) {
+		for (INT32 seed = 1; seed <= SEEDS; seed++) {
+			char name[64];
+			INT32 opts = idle ? idle_programs[p].opts : programs[p].opts;
+
+			sprintf(name, "%s #%d", idle ? idle_programs[p].name : programs[p].name, seed);
+			generate(seed + p * SEEDS + (idle ? 1000 : 0), opts);
+			run(name, SLICES, out);
+		}
+	}
+}
+
+// no busy loops to skip and no code rewritten, every cycle is an
+// instruction dispatched
+static void bench()
+{
+	long long cycles = 0, ns = 0;
+
+	for (INT32 seed = 1; seed <= 4; seed++) {
+		generate(seed, OPT_NOBUSY | OPT_NOPATCH);
+		machine_init();
+
+		for (INT32 s = 0; s < 20000; s++) {
+			struct timespec t0, t1;
+			INT32 slice = 50 + rnd(4000);
+
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			cycles += Sh2Run(slice);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			ns += (t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec);
+
+			if (rnd(16) == 0)
+				Sh2SetIRQLine(10, SH2_IRQSTATUS_AUTO);
+		}
+
+		Sh2Exit();
+	}
+
+	printf("sh2_bench (%s): %.1f M cycles/s\n", SH2_PATH, cycles * 1000.0 / ns);
+}
+
+int main(int argc, char ** argv)
+{
+	INT32 idle = 0;
+
+	Rom  = (UINT8 *)malloc(ROM_SIZE);
+	Bios = (UINT8 *)malloc(BIOS_SIZE);
+	Ram  = (UINT8 *)malloc(RAM_SIZE);
+
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+	if (argc > 1 && !strcmp(argv[1], "idle")) {
+		idle = 1;
+		argc--;
+		argv++;
+	}
+
+	if (argc < 2) {
+		run_all(idle, print_line);
+		return 0;
+	}
+
+	reference = fopen(argv[1], "r");
+	if (reference == NULL) {
+		printf("sh2_test: can't open %s\n", argv[1]);
+		return 1;
+	}
+	run_all(idle, check_line);
+	if (!failed && fgets((char *)Ram, 256, reference)) {
+		printf("sh2_test (" SH2_PATH "): reference has more than %d lines\n", lines);
+		failed = 1;
+	}
+	fclose(reference);
+
+	if (!failed)
+		printf("sh2_test (" SH2_PATH "%s): ok\n", idle ? ", idle loops" : "");
+	return failed;
+}
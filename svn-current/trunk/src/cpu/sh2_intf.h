@@ -10,6 +10,7 @@ typedef unsigned short (__fastcall *pSh2ReadWordHandler)(unsigned int a);
 typedef void (__fastcall *pSh2WriteWordHandler)(unsigned int a, unsigned short d);
 typedef unsigned int (__fastcall *pSh2ReadLongHandler)(unsigned int a);
 typedef void (__fastcall *pSh2WriteLongHandler)(unsigned int a, unsigned int d);
+typedef void (*pSh2PcWatch)(unsigned int pc);
 
 void __fastcall Sh2WriteByte(unsigned int a, unsigned char d);
 unsigned char __fastcall Sh2ReadByte(unsigned int a);
@@ -19,7 +20,23 @@ int Sh2Exit();
 
 void Sh2Open(const int i);
 void Sh2Close();
-int Sh2GetActive();
+int Sh2GetActive();	// -1 while a context of its own is current
+
+// A context is a whole SH-2 with its memory map, handlers and on chip
+// modules. Every other call works on the current one, which Sh2Open sets
+// to one of the Sh2Init contexts. Built with SH2_THREAD_CONTEXTS the
+// current one is kept per thread, so each thread can run a machine of its
+// own but has to pick its context before any other call. Create and
+// destroy from one thread.
+typedef struct Sh2Context Sh2Context;
+
+Sh2Context * Sh2CreateContext();
+void Sh2DestroyContext(Sh2Context * ctx);
+Sh2Context * Sh2SetContext(Sh2Context * ctx);	// returns the one it replaces
+Sh2Context * Sh2GetContext();
+int Sh2ContextRun(Sh2Context * ctx, int cycles);
+void Sh2ContextSetIRQLine(Sh2Context * ctx, const int line, const int state);
+int Sh2ContextScan(Sh2Context * ctx, int nAction);	// Sh2Scan covers the Sh2Init ones only
 
 void Sh2Reset();
 void Sh2Reset(unsigned int pc, unsigned r15); // hack
@@ -27,6 +44,9 @@ int Sh2Run(int cycles);
 
 int Sh2MapMemory(unsigned char* pMemory, unsigned int nStart, unsigned int nEnd, int nType);
 int Sh2MapHandler(uintptr_t nHandler, unsigned int nStart, unsigned int nEnd, int nType);
+void Sh2InvalidateCode(unsigned int nStart, unsigned int nEnd);	// fetch memory rewritten by a handler
+int Sh2SetPcWatch(int i, unsigned int nPc, pSh2PcWatch pCallback);	// called on entering code around nPc, 1 if unsupported
+int Sh2SetIdleHint(unsigned int nPc, unsigned int nAddress);	// poll loop at nPc reading nAddress, skipped if the detector misses it, 1 if unsupported
 
 int Sh2SetReadByteHandler(int i, pSh2ReadByteHandler pHandler);
 int Sh2SetWriteByteHandler(int i, pSh2WriteByteHandler pHandler);